@@ -239,6 +239,7 @@ Page {
         sourceModel: itemsModel
         tag: page.tag
         searchString: filterBar.text
+        library: page.library
     }
 
     TextInputBar {
@@ -65,6 +65,7 @@ Page {
         todoList: page.item.uid
         onlyUndone: true
         searchString: filterBar.text
+        library: page.library
     }
 
     ItemsSortFilterModel {
@@ -75,6 +76,7 @@ Page {
         todoList: page.item.uid
         onlyDone: true
         searchString: filterBar.text
+        library: page.library
     }
 
     TextInputBar {
@@ -95,6 +95,7 @@ Page {
                     }
                     todo: page.todo.uid
                     searchString: filterBar.text
+                    library: page.library
                 }
 
                 anchors {
@@ -20,6 +20,7 @@
 #include "sync/syncjob.h"
 #include "sync/syncrunner.h"
 #include "sync/webdavsynchronizer.h"
+#include "datastorage/itemwriter.h"
 #include "utils/jsonutils.h"
 #include "utils/keystore.h"
 
@@ -70,6 +71,10 @@ void Application::initialize()
 {
     loadLibraries();
 
+    connect(qApp, &QCoreApplication::aboutToQuit, this, [=]() {
+        ItemWriter::instance()->flush();
+    });
+
     connect(m_keyStore, &KeyStore::credentialsLoaded,
             [=](const QString& key, const QString& value, bool success) {
         if (success) {
@@ -133,6 +138,7 @@ void Application::initialize()
  */
 Application::~Application()
 {
+    ItemWriter::instance()->flush();
 }
 
 /**
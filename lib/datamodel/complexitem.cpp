@@ -64,7 +64,7 @@ void ComplexItem::setDueTo(const QDateTime &dueTo)
         t.setHMS(t.hour(), t.minute(), t.second(), 0);
         m_dueTo.setTime(t);
         emit dueToChanged();
-        save();
+        saveLater();
     }
 }
 
@@ -94,7 +94,7 @@ void ComplexItem::setNotes(const QString &notes)
     if (m_notes != copy) {
         m_notes = copy;
         emit notesChanged();
-        save();
+        saveLater();
     }
 }
 
@@ -137,7 +137,7 @@ void ComplexItem::attachFile(const QString &filename)
             m_attachments.append(targetFileName);
             std::stable_sort(m_attachments.begin(), m_attachments.end());
             emit attachmentsChanged();
-            save();
+            saveLater();
         }
     }
 }
@@ -162,7 +162,7 @@ void ComplexItem::detachFile(const QString &filename)
             }
             m_attachments.removeAll(filename);
             emit attachmentsChanged();
-            save();
+            saveLater();
         }
     }
 }
@@ -179,7 +179,7 @@ void ComplexItem::setAttachments(const QStringList &attachments)
     if (m_attachments != attachments) {
         m_attachments = attachments;
         emit attachmentsChanged();
-        save();
+        saveLater();
     }
 }
 
@@ -57,19 +57,19 @@ void Image::setImage(const QString &image)
     if (m_image != image) {
         if (!isValid()) {
             m_image = image;
-            save();
+            saveLater();
             emit imageChanged();
         } else {
             QFileInfo fi(image);
             if (fi.isRelative()) {
                 m_image = image;
                 emit imageChanged();
-                save();
+                saveLater();
             } else {
                 if (fi.absolutePath() == directory()) {
                     m_image = fi.fileName();
                     emit imageChanged();
-                    save();
+                    saveLater();
                 } else if (isValid()) {
                     if (!fi.exists()) {
                         return;
@@ -80,7 +80,7 @@ void Image::setImage(const QString &image)
                     QFile::copy(image, directory() + "/" + targetFileName);
                     m_image = targetFileName;
                     emit imageChanged();
-                    save();
+                    saveLater();
                 }
             }
         }
@@ -7,6 +7,7 @@
 #include "task.h"
 
 #include "fileutils.h"
+#include "itemwriter.h"
 #include "utils/jsonutils.h"
 
 #include <QDebug>
@@ -34,7 +35,8 @@ Item::Item(QObject* parent) :
     m_filename(),
     m_title(),
     m_uid(QUuid::createUuid()),
-    m_loading(false)
+    m_loading(false),
+    m_fileCache(new JsonUtils::JsonFileCache)
 {
     setupChangedSignal();
 }
@@ -83,6 +85,7 @@ bool Item::deleteItem()
 {
     bool result = false;
     if (isValid()) {
+        ItemWriter::instance()->cancel(m_filename);
         QFile file(m_filename);
         if (file.exists()) {
             result = file.remove();
@@ -100,7 +103,8 @@ bool Item::deleteItem()
 bool Item::load()
 {
     bool ok = false;
-    auto map = JsonUtils::loadMap(m_filename, &ok);
+    ItemWriter::instance()->flush(m_filename);
+    auto map = JsonUtils::loadMap(m_filename, &ok, m_fileCache.data());
     if (ok) {
         auto loading = m_loading;
         m_loading = true;
@@ -116,6 +120,10 @@ bool Item::load()
  * Use this to trigger a save operation of the item back to disk. This should in particular
  * be called in property setters of sub-classes of the item class.
  *
+ * The data is written immediately. Property setters should rather use
+ * saveLater(), which merges subsequent changes and writes them in the
+ * background.
+ *
  * @note This method will have no effect during a load() or any other operation during
  * which the item is restored from its persisted state.
  */
@@ -124,12 +132,28 @@ bool Item::save()
     bool result = false;
     if (!m_loading) {
         if (isValid()) {
-            result = JsonUtils::patchJsonFile(m_filename, toMap());
+            result = ItemWriter::instance()->write(m_filename, toMap(), m_fileCache);
         }
     }
     return result;
 }
 
+/**
+ * @brief Schedule saving the item data back to disk.
+ *
+ * This records the current state of the item in the ItemWriter, which
+ * writes it to disk in the background. Several changes to the item in a
+ * short time result in a single write.
+ *
+ * @note Like save(), this has no effect while the item is being loaded.
+ */
+void Item::saveLater()
+{
+    if (!m_loading && isValid()) {
+        ItemWriter::instance()->schedule(m_filename, toMap(), m_fileCache);
+    }
+}
+
 /**
  * @brief Save the item to a QVariant for persistence.
  *
@@ -202,7 +226,7 @@ void Item::setWeight(double weight)
     if (!qFuzzyCompare(m_weight, weight)) {
         m_weight = weight;
         emit weightChanged();
-        save();
+        saveLater();
     }
 }
 
@@ -278,11 +302,13 @@ Item* Item::createItemFromFile(QString filename, QObject* parent)
 {
     Item *result = nullptr;
     bool ok;
-    auto map = JsonUtils::loadMap(filename, &ok);
+    auto cache = JsonUtils::JsonFileCachePtr::create();
+    auto map = JsonUtils::loadMap(filename, &ok, cache.data());
     if (ok) {
         result = createItem(map, parent);
         if (result != nullptr) {
             result->setFilename(filename);
+            result->m_fileCache = cache;
         }
     }
     return result;
@@ -296,7 +322,7 @@ void Item::setTitle(const QString &title)
     if ( m_title != title ) {
         m_title = title;
         emit titleChanged();
-        save();
+        saveLater();
     }
 }
 
@@ -9,6 +9,8 @@
 #include <QUuid>
 #include <QVariantMap>
 
+#include "utils/jsonutils.h"
+
 
 /**
  * @brief Base class for all items in a library.
@@ -124,6 +126,8 @@ protected:
     virtual QVariantMap toMap() const;
     virtual void fromMap(QVariantMap map);
 
+    void saveLater();
+
 private:
 
     QString     m_filename;
@@ -132,6 +136,8 @@ private:
     double      m_weight;
     bool        m_loading;
 
+    JsonUtils::JsonFileCachePtr m_fileCache;
+
     void setFilename(const QString &filename);
 
     void setupChangedSignal();
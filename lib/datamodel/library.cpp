@@ -3,10 +3,12 @@
 #include <QDebug>
 #include <QDir>
 #include <QQmlEngine>
+#include <QSet>
 #include <QtConcurrent>
 #include <QTimer>
 
 #include "application.h"
+#include "itemwriter.h"
 #include "libraryloader.h"
 #include "toplevelitem.h"
 #include "todolist.h"
@@ -16,13 +18,25 @@
 
 #include "utils/jsonutils.h"
 
-#include "utils/directorywatcher.h"
-
 
 const QString Library::LibraryFileName = "library.json";
 
 Q_LOGGING_CATEGORY(library, "net.rpdev.opentodolist.Library")
 
+
+/**
+ * @brief Get the text of the @p item which is used for searching.
+ */
+static QString searchText(Item *item)
+{
+    auto result = item->title();
+    auto complexItem = qobject_cast<ComplexItem*>(item);
+    if (complexItem != nullptr) {
+        result += "\n" + complexItem->notes();
+    }
+    return result;
+}
+
 /**
    @brief Set the name of the library.
  */
@@ -33,20 +47,30 @@ Library::Library(QObject* parent) : QObject(parent),
     m_topLevelItems(this),
     m_todos(this),
     m_tasks(this),
+    m_todosOfTodoList(),
+    m_tasksOfTodo(),
+    m_parents(),
+    m_todosByUid(),
+    m_taskCounts(),
+    m_doneTasks(),
+    m_searchIndex(),
+    m_tagsOfItem(),
+    m_itemsWithTag(),
+    m_tags(),
+    m_tagsValid(true),
     m_directoryWatcher(new DirectoryWatcher(this)),
+    m_reloadTimer(new QTimer(this)),
+    m_pendingChanges(),
     m_loading(false),
     m_synchronizing(false),
     m_secretsMissing(false),
     m_syncErrors()
 {
-    auto timer = new QTimer(this);
-    timer->setInterval(5000);
-    timer->setSingleShot(true);
-    connect(timer, &QTimer::timeout, this, &Library::load);
-    connect(m_directoryWatcher, &DirectoryWatcher::directoryChanged, timer,
-            static_cast<void(QTimer::*)()>(&QTimer::start));
-    connect(&m_topLevelItems, &ItemContainer::countChanged,
-            this, &Library::tagsChanged);
+    m_reloadTimer->setInterval(5000);
+    m_reloadTimer->setSingleShot(true);
+    connect(m_reloadTimer, &QTimer::timeout, this, &Library::applyFileChanges);
+    connect(m_directoryWatcher, &DirectoryWatcher::filesChanged,
+            this, &Library::queueFileChanges);
 }
 
 Library::Library(const QString& directory, QObject* parent) : Library(parent)
@@ -189,6 +213,9 @@ void Library::deleteLibrary(bool deleteFiles, std::function<void ()> callback)
     emit deletingLibrary(this);
     QString directory = m_directory;
     m_directoryWatcher->setDirectory(QString());
+    m_reloadTimer->stop();
+    m_pendingChanges = FileChangeSet();
+    ItemWriter::instance()->flush();
     if (isValid() && deleteFiles) {
         QtConcurrent::run([=](){
             auto years = Library::years(directory);
@@ -196,7 +223,7 @@ void Library::deleteLibrary(bool deleteFiles, std::function<void ()> callback)
                 auto months = Library::months(directory, year);
                 for (auto month : months) {
                     QDir dir(directory + "/" + year + "/" + month);
-                    for (auto entry : dir.entryList(QDir::Files)) {
+                    for (auto entry : dir.entryList(QDir::Files | QDir::Hidden)) {
                         if (!dir.remove(entry)) {
                             qCWarning(library) << "Failed to remove file" << entry << "from"
                                                << dir.absolutePath();
@@ -240,6 +267,8 @@ bool Library::load()
 {
     bool result = false;
     if (isValid()) {
+        // Recover files from writes that got interrupted:
+        JsonUtils::recoverTempFiles(m_directory);
         QDir dir(m_directory);
         QString filename = dir.absoluteFilePath(LibraryFileName);
         bool ok;
@@ -250,6 +279,8 @@ bool Library::load()
         }
     }
     if (!m_loading && isValid()) {
+        // Make sure the loader sees the latest state of our items:
+        ItemWriter::instance()->flush();
         setLoading(true);
         LibraryLoader *loader = new LibraryLoader(this);
         loader->setDirectory(m_directory);
@@ -258,7 +289,7 @@ bool Library::load()
             emit loadingFinished();
             loader->deleteLater();
         });
-        connect(loader, &LibraryLoader::itemLoaded, this, &Library::appendItem);
+        connect(loader, &LibraryLoader::itemsLoaded, this, &Library::appendItems);
         loader->scan();
     }
     return result;
@@ -413,18 +444,57 @@ QUuid Library::uid() const
  * @brief Get the list of tags in the library.
  *
  * This returns the list of tags - sorted alphabetically - used within the library.
+ * The library keeps track of which items use each tag; the sorted list is cached
+ * and only rebuilt after a tag has been used for the first time or has been
+ * removed from the last item using it.
  */
 QStringList Library::tags() const
 {
-    QSet<QString> tags;
-    for (int i = 0; i < m_topLevelItems.count(); ++i) {
-        auto item = qSharedPointerDynamicCast<TopLevelItem>(m_topLevelItems.item(i));
-        for (auto tag : item->tags()) {
-            tags.insert(tag);
+    if (!m_tagsValid) {
+        m_tags = m_itemsWithTag.keys();
+        m_tags.sort(Qt::CaseInsensitive);
+        m_tagsValid = true;
+    }
+    return m_tags;
+}
+
+
+/**
+ * @brief Get the uids of the items which are tagged with the given @p tags.
+ *
+ * If @p matchAll is true, only items which have all of the tags are
+ * returned. Otherwise, items which have at least one of the tags are
+ * returned. The result is computed from an index, so the cost depends on
+ * the number of tagged items rather than on the size of the library.
+ */
+QSet<QUuid> Library::itemsWithTags(const QStringList& tags, bool matchAll) const
+{
+    QSet<QUuid> result;
+    if (matchAll) {
+        // Start with the smallest set to keep the intersections cheap:
+        QList<QSet<QUuid>> sets;
+        for (auto tag : tags) {
+            auto items = m_itemsWithTag.value(tag);
+            if (items.isEmpty()) {
+                return QSet<QUuid>();
+            }
+            sets << items;
+        }
+        std::sort(sets.begin(), sets.end(),
+                  [](const QSet<QUuid> &a, const QSet<QUuid> &b) {
+            return a.size() < b.size();
+        });
+        if (!sets.isEmpty()) {
+            result = sets.takeFirst();
+            for (auto set : sets) {
+                result.intersect(set);
+            }
+        }
+    } else {
+        for (auto tag : tags) {
+            result.unite(m_itemsWithTag.value(tag));
         }
     }
-    auto result = tags.values();
-    result.sort(Qt::CaseInsensitive);
     return result;
 }
 
@@ -613,24 +683,408 @@ void Library::fromMap(QVariantMap map)
 
 void Library::appendItem(ItemPtr item)
 {
-    auto topLevelItem = qSharedPointerDynamicCast<TopLevelItem>(item);
-    if (!topLevelItem.isNull()) {
-        auto todoList = qSharedPointerDynamicCast<TodoList>(item);
-        if (todoList) {
-            todoList->m_library = this;
+    appendItems({item});
+}
+
+/**
+ * @brief Add the @p items to the library.
+ *
+ * The items are sorted into the containers of the library. Each container
+ * receives its new items in a single bulk operation.
+ */
+void Library::appendItems(QList<ItemPtr> items)
+{
+    QList<ItemPtr> topLevelItems;
+    QList<ItemPtr> todos;
+    QList<ItemPtr> tasks;
+    for (auto item : items) {
+        auto topLevelItem = qSharedPointerDynamicCast<TopLevelItem>(item);
+        if (!topLevelItem.isNull()) {
+            auto todoList = qSharedPointerDynamicCast<TodoList>(item);
+            if (todoList) {
+                todoList->m_library = this;
+            }
+            topLevelItems << item;
+        } else {
+            auto todo = qSharedPointerDynamicCast<Todo>(item);
+            if (!todo.isNull()) {
+                todo->setLibrary(this);
+                todos << item;
+            } else {
+                auto task = qSharedPointerDynamicCast<Task>(item);
+                if (!task.isNull()) {
+                    tasks << item;
+                }
+            }
         }
-        m_topLevelItems.updateOrInsert(item);
-        connect(topLevelItem.data(), &TopLevelItem::tagsChanged, this, &Library::tagsChanged);
+    }
+    auto newItems = m_topLevelItems.updateOrInsertItems(topLevelItems) +
+            m_todos.updateOrInsertItems(todos) +
+            m_tasks.updateOrInsertItems(tasks);
+    bool tagsModified = false;
+    bool itemTagsModified = false;
+    for (auto item : newItems) {
+        indexItem(item.data());
+        auto topLevelItem = qSharedPointerObjectCast<TopLevelItem>(item);
+        if (!topLevelItem.isNull()) {
+            connect(topLevelItem.data(), &TopLevelItem::tagsChanged,
+                    this, &Library::handleTagsChanged);
+            auto tags = topLevelItem->tags().toSet();
+            itemTagsModified = itemTagsModified || !tags.isEmpty();
+            tagsModified = updateTags(item.data(), tags) || tagsModified;
+        }
+    }
+    if (!newItems.isEmpty()) {
+        emit searchIndexChanged();
+        emit itemsAdded(newItems);
+    }
+    if (tagsModified) {
+        emit tagsChanged();
+    }
+    if (itemTagsModified) {
+        emit itemTagsChanged();
+    }
+}
+
+/**
+ * @brief Get the todos which belong to the todo list with the given uid.
+ *
+ * This uses an index maintained by the library and hence does not need to
+ * iterate over all todos.
+ */
+QList<Todo*> Library::todosOf(const QUuid& todoListUid) const
+{
+    QList<Todo*> result;
+    for (auto item : m_todosOfTodoList.values(todoListUid)) {
+        result << static_cast<Todo*>(item);
+    }
+    return result;
+}
+
+/**
+ * @brief Get the tasks which belong to the todo with the given uid.
+ *
+ * This uses an index maintained by the library and hence does not need to
+ * iterate over all tasks.
+ */
+QList<Task*> Library::tasksOf(const QUuid& todoUid) const
+{
+    QList<Task*> result;
+    for (auto item : m_tasksOfTodo.values(todoUid)) {
+        result << static_cast<Task*>(item);
+    }
+    return result;
+}
+
+/**
+ * @brief Search for items.
+ *
+ * This returns the uids of the items whose title or notes contain a word
+ * starting with any of the words in the @p searchString. The uids of the
+ * todo and todo list an item belongs to are included as well, so parents
+ * can be shown if one of their children matches.
+ */
+QSet<QUuid> Library::search(const QString& searchString) const
+{
+    return m_searchIndex.find(searchString);
+}
+
+/**
+ * @brief Get a copy of the search index of the library.
+ *
+ * The copy is cheap and can be used to search in a background thread.
+ */
+SearchIndex Library::searchIndex() const
+{
+    return m_searchIndex;
+}
+
+/**
+ * @brief Add the @p item to the indexes of the library.
+ *
+ * Every item is added to the search index. Todos and tasks additionally are
+ * added to the parent-child indexes. If the item already is indexed, it is
+ * moved to the entry of its current parent.
+ */
+void Library::indexItem(Item* item)
+{
+    if (!m_searchIndex.contains(item)) {
+        connect(item, &Item::itemDeleted, this, &Library::unindexItem);
+        connect(item, &QObject::destroyed, this, &Library::handleItemDestroyed);
+        connect(item, &Item::titleChanged, this, &Library::handleSearchTextChanged);
+        auto complexItem = qobject_cast<ComplexItem*>(item);
+        if (complexItem != nullptr) {
+            connect(complexItem, &ComplexItem::notesChanged,
+                    this, &Library::handleSearchTextChanged);
+        }
+        m_searchIndex.insert(item, item->uid(), searchText(item));
+    }
+
+    auto todo = qobject_cast<Todo*>(item);
+    auto task = qobject_cast<Task*>(item);
+    if (todo == nullptr && task == nullptr) {
+        return;
+    }
+    auto it = m_parents.find(item);
+    if (it == m_parents.end()) {
+        if (todo != nullptr) {
+            connect(todo, &Todo::todoListUidChanged, this, &Library::handleParentChanged);
+            m_todosByUid.insert(todo->uid(), todo);
+        } else {
+            connect(task, &Task::todoUidChanged, this, &Library::handleParentChanged);
+            connect(task, &Task::doneChanged, this, &Library::handleTaskDoneChanged);
+        }
+    } else {
+        m_todosOfTodoList.remove(it->parentUid, item);
+        if (m_tasksOfTodo.remove(it->parentUid, item) > 0) {
+            countTask(it->parentUid, -1, m_doneTasks.contains(item) ? -1 : 0);
+        }
+    }
+    if (todo != nullptr) {
+        m_parents.insert(item, ItemParent{todo->uid(), todo->todoListUid()});
+        m_todosOfTodoList.insert(todo->todoListUid(), item);
+        m_searchIndex.setParent(item, todo->todoListUid());
     } else {
-        auto todo = qSharedPointerDynamicCast<Todo>(item);
-        if (!todo.isNull()) {
-            todo->setLibrary(this);
-            m_todos.updateOrInsert(item);
+        m_parents.insert(item, ItemParent{task->uid(), task->todoUid()});
+        m_searchIndex.setParent(item, task->todoUid());
+        m_tasksOfTodo.insert(task->todoUid(), item);
+        if (task->done()) {
+            m_doneTasks.insert(item);
         } else {
-            auto task = qSharedPointerDynamicCast<Task>(item);
-            if (!task.isNull()) {
-                m_tasks.updateOrInsert(item);
+            m_doneTasks.remove(item);
+        }
+        countTask(task->todoUid(), 1, task->done() ? 1 : 0);
+    }
+}
+
+/**
+ * @brief Adjust the number of (done) tasks of the todo with the given uid.
+ *
+ * If the todo is loaded, it is notified that its percentageDone changed.
+ */
+void Library::countTask(const QUuid& todoUid, int total, int done)
+{
+    auto &counts = m_taskCounts[todoUid];
+    counts.total += total;
+    counts.done += done;
+    if (counts.total <= 0) {
+        m_taskCounts.remove(todoUid);
+    }
+    auto todo = m_todosByUid.value(todoUid);
+    if (todo != nullptr) {
+        emit todo->percentageDoneChanged();
+    }
+}
+
+/**
+ * @brief Remove the @p item from the indexes of the library.
+ */
+void Library::unindexItem(Item* item)
+{
+    if (m_searchIndex.remove(item)) {
+        emit searchIndexChanged();
+    }
+    if (m_tagsOfItem.contains(item)) {
+        if (updateTags(item, QSet<QString>())) {
+            emit tagsChanged();
+        }
+        emit itemTagsChanged();
+    }
+    auto it = m_parents.find(item);
+    if (it != m_parents.end()) {
+        // Note: The item might already be partially destroyed, so we
+        // cannot ask it for its uid but use the one recorded in the index.
+        if (m_todosOfTodoList.remove(it->parentUid, item) > 0 &&
+                m_todosByUid.value(it->uid) == item) {
+            m_todosByUid.remove(it->uid);
+        }
+        if (m_tasksOfTodo.remove(it->parentUid, item) > 0) {
+            countTask(it->parentUid, -1, m_doneTasks.remove(item) ? -1 : 0);
+        }
+        m_parents.erase(it);
+    }
+}
+
+void Library::handleItemDestroyed(QObject* object)
+{
+    // Note: The object is already partially destroyed, so we only use
+    // the pointer as key.
+    unindexItem(static_cast<Item*>(object));
+}
+
+void Library::handleParentChanged()
+{
+    auto item = static_cast<Item*>(sender());
+    if (m_parents.contains(item)) {
+        indexItem(item);
+        emit searchIndexChanged();
+    }
+}
+
+/**
+ * @brief Set the @p tags used by the @p item.
+ *
+ * This updates the tag index of the library. Returns true if the list of tags
+ * in the library changed, i.e. if a tag is used for the first time or no longer
+ * used by any item.
+ *
+ * @note Removing all tags of an item is safe even if the item is being
+ * destroyed.
+ */
+bool Library::updateTags(Item* item, const QSet<QString>& tags)
+{
+    bool result = false;
+    auto entry = m_tagsOfItem.value(item);
+    if (entry.tags == tags) {
+        return false;
+    }
+    if (entry.uid.isNull()) {
+        entry.uid = item->uid();
+    }
+    for (auto tag : entry.tags - tags) {
+        auto items = m_itemsWithTag.find(tag);
+        items->remove(entry.uid);
+        if (items->isEmpty()) {
+            m_itemsWithTag.erase(items);
+            result = true;
+        }
+    }
+    for (auto tag : tags - entry.tags) {
+        auto &items = m_itemsWithTag[tag];
+        items.insert(entry.uid);
+        if (items.size() == 1) {
+            result = true;
+        }
+    }
+    if (tags.isEmpty()) {
+        m_tagsOfItem.remove(item);
+    } else {
+        entry.tags = tags;
+        m_tagsOfItem.insert(item, entry);
+    }
+    if (result) {
+        m_tagsValid = false;
+    }
+    return result;
+}
+
+void Library::handleTagsChanged()
+{
+    auto item = static_cast<TopLevelItem*>(sender());
+    if (m_searchIndex.contains(item)) {
+        if (updateTags(item, item->tags().toSet())) {
+            emit tagsChanged();
+        }
+        emit itemTagsChanged();
+    }
+}
+
+void Library::handleSearchTextChanged()
+{
+    auto item = static_cast<Item*>(sender());
+    if (m_searchIndex.contains(item)) {
+        m_searchIndex.insert(item, item->uid(), searchText(item));
+        emit searchIndexChanged();
+    }
+}
+
+void Library::handleTaskDoneChanged()
+{
+    auto task = static_cast<Task*>(sender());
+    auto it = m_parents.find(task);
+    if (it != m_parents.end()) {
+        if (task->done() && !m_doneTasks.contains(task)) {
+            m_doneTasks.insert(task);
+            countTask(it->parentUid, 0, 1);
+        } else if (!task->done() && m_doneTasks.remove(task)) {
+            countTask(it->parentUid, 0, -1);
+        }
+    }
+}
+
+/**
+ * @brief Record @p changes to files in the library directory.
+ *
+ * Changes are collected and applied after a short delay, so that a burst
+ * of changes (e.g. during a sync) is handled at once.
+ */
+void Library::queueFileChanges(const FileChangeSet& changes)
+{
+    m_pendingChanges.merge(changes);
+    m_reloadTimer->start();
+}
+
+/**
+ * @brief Reload the items whose files have been changed.
+ *
+ * Items whose files have been removed are removed from the library. Added
+ * and modified files are loaded (skipping the ones which did not change
+ * since they have been loaded last) and the items are updated or added.
+ */
+void Library::applyFileChanges()
+{
+    if (!isValid()) {
+        m_pendingChanges = FileChangeSet();
+        return;
+    }
+    if (m_loading) {
+        // Try again once the running load finished:
+        m_reloadTimer->start();
+        return;
+    }
+    auto changes = m_pendingChanges;
+    m_pendingChanges = FileChangeSet();
+
+    // Items with pending writes must not be reverted to the data on disk:
+    ItemWriter::instance()->flush();
+
+    QDir dir(m_directory);
+    auto libraryFile = dir.absoluteFilePath(LibraryFileName);
+    auto suffix = "." + Item::FileNameSuffix;
+    QStringList files;
+    for (auto file : changes.added + changes.modified) {
+        if (file == libraryFile) {
+            bool ok;
+            auto map = JsonUtils::loadMap(libraryFile, &ok);
+            if (ok) {
+                fromMap(map);
             }
+        } else if (file.endsWith(suffix)) {
+            files << file;
         }
     }
+
+    QSet<QString> removedFiles;
+    for (auto file : changes.removed) {
+        if (file.endsWith(suffix)) {
+            removedFiles.insert(file);
+            files << file;
+        }
+    }
+    if (!removedFiles.isEmpty()) {
+        for (auto container : {&m_topLevelItems, &m_todos, &m_tasks}) {
+            QList<ItemPtr> removedItems;
+            for (int i = 0; i < container->count(); ++i) {
+                auto item = container->item(i);
+                if (!item.isNull() && removedFiles.contains(item->filename())) {
+                    removedItems << item;
+                }
+            }
+            for (auto item : removedItems) {
+                unindexItem(item.data());
+                container->deleteItem(item);
+            }
+        }
+    }
+
+    if (!files.isEmpty()) {
+        qCDebug(library) << "Reloading" << files.count() << "changed files in"
+                         << m_directory;
+        auto loader = new LibraryLoader(this);
+        loader->setDirectory(m_directory);
+        connect(loader, &LibraryLoader::itemsLoaded, this, &Library::appendItems);
+        connect(loader, &LibraryLoader::scanFinished, loader, &LibraryLoader::deleteLater);
+        loader->loadFiles(files);
+    }
+    emit filesChanged(changes);
 }
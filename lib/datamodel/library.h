@@ -4,18 +4,25 @@
 #include <functional>
 
 #include <QDir>
+#include <QHash>
 #include <QLoggingCategory>
 #include <QObject>
+#include <QSet>
 #include <QString>
 #include <QVariantMap>
 
 #include "image.h"
 #include "itemcontainer.h"
 #include "note.h"
+#include "searchindex.h"
 #include "todolist.h"
+#include "utils/directorywatcher.h"
+
+class QTimer;
 
-class DirectoryWatcher;
 class Application;
+class Task;
+class Todo;
 class Synchronizer;
 
 /**
@@ -44,6 +51,8 @@ class Library : public QObject
     Q_PROPERTY(bool isInDefaultLocation READ isInDefaultLocation CONSTANT)
 
     friend class Application;
+    friend class Todo;
+    friend class TodoList;
 
 public:
 
@@ -81,6 +90,12 @@ public:
     ItemContainer *todos();
     ItemContainer *tasks();
 
+    QList<Todo*> todosOf(const QUuid &todoListUid) const;
+    QList<Task*> tasksOf(const QUuid &todoUid) const;
+
+    QSet<QUuid> search(const QString &searchString) const;
+    SearchIndex searchIndex() const;
+
     QString newItemLocation() const;
 
     static QStringList years(const QString &directory);
@@ -91,6 +106,7 @@ public:
     bool loading() const;
     QUuid uid() const;
     QStringList tags() const;
+    QSet<QUuid> itemsWithTags(const QStringList &tags, bool matchAll = true) const;
 
     void fromJson(const QByteArray data);
 
@@ -123,6 +139,15 @@ signals:
      */
     void tagsChanged();
 
+    /**
+     * @brief The tags of at least one item in the library changed.
+     *
+     * In contrast to tagsChanged(), this signal is emitted whenever a tag
+     * is added to or removed from an item, even if the list of tags
+     * used in the library stays the same.
+     */
+    void itemTagsChanged();
+
     /**
      * @brief A library is about to be deleted.
      *
@@ -153,6 +178,27 @@ signals:
 
     void syncErrorsChanged();
 
+    /**
+     * @brief The search index of the library changed.
+     *
+     * This signal is emitted whenever items are added to or removed from the
+     * search index or the searchable text of an item changed.
+     */
+    void searchIndexChanged();
+
+    /**
+     * @brief The @p items have been added to the library.
+     */
+    void itemsAdded(const QList<ItemPtr> &items);
+
+    /**
+     * @brief Files in the library directory have been added, modified or removed.
+     *
+     * This signal is emitted when the library applies the @p changes, i.e.
+     * after changes on disk have been collected for a while.
+     */
+    void filesChanged(const FileChangeSet &changes);
+
 public slots:
 
     void addSyncError(const QString &error);
@@ -160,6 +206,21 @@ public slots:
 
 private:
 
+    struct TaskCounts {
+        int total;
+        int done;
+    };
+
+    struct ItemParent {
+        QUuid           uid;
+        QUuid           parentUid;
+    };
+
+    struct ItemTags {
+        QUuid           uid;
+        QSet<QString>   tags;
+    };
+
     QUuid                   m_uid;
     QString                 m_name;
     QString                 m_directory;
@@ -168,7 +229,21 @@ private:
     ItemContainer           m_todos;
     ItemContainer           m_tasks;
 
+    QMultiHash<QUuid, Item*> m_todosOfTodoList;
+    QMultiHash<QUuid, Item*> m_tasksOfTodo;
+    QHash<Item*, ItemParent> m_parents;
+    QHash<QUuid, Todo*>     m_todosByUid;
+    QHash<QUuid, TaskCounts> m_taskCounts;
+    QSet<Item*>             m_doneTasks;
+    SearchIndex             m_searchIndex;
+    QHash<Item*, ItemTags>  m_tagsOfItem;
+    QHash<QString, QSet<QUuid>> m_itemsWithTag;
+    mutable QStringList     m_tags;
+    mutable bool            m_tagsValid;
+
     DirectoryWatcher       *m_directoryWatcher;
+    QTimer                 *m_reloadTimer;
+    FileChangeSet           m_pendingChanges;
 
     bool                    m_loading;
     bool                    m_synchronizing;
@@ -181,9 +256,22 @@ private:
     void setUid(const QUuid& uid);
     void setLoading(bool loading);
 
+    void indexItem(Item *item);
+    void countTask(const QUuid &todoUid, int total, int done);
+    bool updateTags(Item *item, const QSet<QString> &tags);
+
 private slots:
 
     void appendItem(ItemPtr item);
+    void appendItems(QList<ItemPtr> items);
+    void unindexItem(Item *item);
+    void handleItemDestroyed(QObject *object);
+    void handleParentChanged();
+    void handleTaskDoneChanged();
+    void handleSearchTextChanged();
+    void handleTagsChanged();
+    void queueFileChanges(const FileChangeSet &changes);
+    void applyFileChanges();
 
 };
 
@@ -41,7 +41,7 @@ void Task::setDone(bool done)
     if (m_done != done) {
         m_done = done;
         emit doneChanged();
-        save();
+        saveLater();
     }
 }
 
@@ -58,7 +58,7 @@ void Task::setTodoUid(const QUuid& todoUid)
     if (m_todoUid != todoUid) {
         m_todoUid = todoUid;
         emit todoUidChanged();
-        save();
+        saveLater();
     }
 }
 
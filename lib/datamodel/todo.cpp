@@ -61,7 +61,7 @@ void Todo::setDone(bool done)
     if (m_done != done) {
         m_done = done;
         emit doneChanged();
-        save();
+        saveLater();
     }
 }
 
@@ -81,7 +81,7 @@ void Todo::setTodoListUid(const QUuid& todoListUid)
     if (m_todoListUid != todoListUid) {
         m_todoListUid = todoListUid;
         emit todoListUidChanged();
-        save();
+        saveLater();
     }
 }
 
@@ -106,7 +106,7 @@ Task*Todo::addTask()
         } else {
             task = TaskPtr(new Task());
         }
-        m_library->tasks()->addItem(task);
+        m_library->appendItem(task);
         task->setTodoUid(uid());
         task->setWeight(m_library->tasks()->nextItemWeight());
         QQmlEngine::setObjectOwnership(task.data(), QQmlEngine::CppOwnership);
@@ -122,32 +122,18 @@ Task*Todo::addTask()
  *
  * This returns the percentage (as a number between 0 and 100) the todo is
  * done. That value is derived from the number of tasks the todo contains and
- * how many of them are done.
+ * how many of them are done. The library keeps track of these numbers and
+ * notifies the todo when they change.
  */
 int Todo::percentageDone() const
 {
-    auto uid = this->uid();
-    int totalTasks = 0;
-    int completeTasks = 0;
     if (m_library != nullptr) {
-        auto tasks = m_library->tasks();
-        for (int i = 0; i < tasks->count(); ++i) {
-            auto task = dynamic_cast<Task*>(tasks->get(i));
-            if (task != nullptr) {
-                if (task->todoUid() == uid) {
-                    ++totalTasks;
-                    if (task->done()) {
-                        ++completeTasks;
-                    }
-                }
-            }
+        auto counts = m_library->m_taskCounts.value(uid());
+        if (counts.total > 0) {
+            return counts.done * 100 / counts.total;
         }
     }
-    if (totalTasks > 0) {
-        return completeTasks * 100 / totalTasks;
-    } else {
-        return 0;
-    }
+    return 0;
 }
 
 
@@ -169,32 +155,11 @@ void Todo::fromMap(QVariantMap map)
 
 void Todo::setLibrary(Library *library)
 {
-    if (m_library != nullptr) {
-        disconnect(m_library->tasks(), &ItemContainer::countChanged,
-                   this, &Todo::percentageDoneChanged);
-        disconnect(m_library->tasks(), &ItemContainer::itemChanged,
-                   this, &Todo::handleTaskChanged);
-    }
     m_library = library;
-    if (m_library != nullptr) {
-        connect(m_library->tasks(), &ItemContainer::countChanged,
-                this, &Todo::percentageDoneChanged);
-        connect(m_library->tasks(), &ItemContainer::itemChanged,
-                this, &Todo::handleTaskChanged);
-    }
     emit percentageDoneChanged();
 }
 
 
-void Todo::handleTaskChanged(int index)
-{
-    auto task = dynamic_cast<Task*>(m_library->tasks()->get(index));
-    if (task->todoUid() == uid()) {
-        emit percentageDoneChanged();
-    }
-}
-
-
 Library *Todo::library() const
 {
     return m_library;
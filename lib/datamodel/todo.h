@@ -71,10 +71,6 @@ private:
 
     void setLibrary(Library* library);
 
-private slots:
-
-    void handleTaskChanged(int index);
-
 };
 
 typedef QSharedPointer<Todo> TodoPtr;
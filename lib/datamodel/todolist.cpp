@@ -61,7 +61,7 @@ Todo *TodoList::addTodo()
         todo->setLibrary(m_library);
         todo->setTodoListUid(uid());
         todo->setWeight(m_library->todos()->nextItemWeight());
-        m_library->todos()->addItem(todo);
+        m_library->appendItem(todo);
         QQmlEngine::setObjectOwnership(todo.data(), QQmlEngine::CppOwnership);
         todo->save();
         return todo.data();
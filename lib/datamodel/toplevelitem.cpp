@@ -56,7 +56,7 @@ void TopLevelItem::setColor(const Color &color)
     if (m_color != color) {
         m_color = color;
         emit colorChanged();
-        save();
+        saveLater();
     }
 }
 
@@ -88,7 +88,7 @@ void TopLevelItem::setTags(const QStringList& tags)
     {
         m_tags = tags;
         emit tagsChanged();
-        save();
+        saveLater();
     }
 }
 
@@ -104,7 +104,7 @@ void TopLevelItem::addTag(const QString& tag)
     {
         m_tags.append(tag);
         m_tags.sort();
-        save();
+        saveLater();
         emit tagsChanged();
     }
 }
@@ -119,7 +119,7 @@ void TopLevelItem::removeTagAt(int index)
 {
     Q_ASSERT(index >= 0 && index < m_tags.length());
     m_tags.removeAt(index);
-    save();
+    saveLater();
     emit tagsChanged();
 }
 
@@ -4,6 +4,7 @@
 
 #include <QMutexLocker>
 #include <QtConcurrent>
+#include <QThread>
 #include <QThreadPool>
 
 
@@ -12,7 +13,11 @@
  */
 ItemContainer::ItemContainer(QObject *parent) : QObject(parent),
     m_items(),
+    m_snapshot(new Snapshot()),
+    m_pendingSnapshots(),
+    m_snapshotSerial(0),
     m_uidMap(),
+    m_rowIndex(),
     m_threadPool(new QThreadPool(this)),
     m_lock(QMutex::Recursive),
     m_minWeight(std::numeric_limits<double>::infinity()),
@@ -22,6 +27,8 @@ ItemContainer::ItemContainer(QObject *parent) : QObject(parent),
     m_threadPool->setMaxThreadCount(1);
     connect(this, &ItemContainer::itemAdded,
             this, &ItemContainer::countChanged);
+    connect(this, &ItemContainer::itemsAdded,
+            this, &ItemContainer::countChanged);
     connect(this, &ItemContainer::itemDeleted,
             this, &ItemContainer::countChanged);
 }
@@ -32,6 +39,8 @@ ItemContainer::ItemContainer(QObject *parent) : QObject(parent),
 ItemContainer::~ItemContainer()
 {
     delete m_threadPool;
+    qDeleteAll(m_pendingSnapshots);
+    delete m_snapshot.loadAcquire();
 }
 
 /**
@@ -39,6 +48,9 @@ ItemContainer::~ItemContainer()
  */
 int ItemContainer::count() const
 {
+    if (QThread::currentThread() == thread()) {
+        return m_snapshot.loadAcquire()->length();
+    }
     QMutexLocker l(&m_lock);
     return m_items.length();
 }
@@ -51,6 +63,13 @@ int ItemContainer::count() const
  */
 ItemPtr ItemContainer::item(int index) const
 {
+    if (QThread::currentThread() == thread()) {
+        auto snapshot = m_snapshot.loadAcquire();
+        if (index >= 0 && index < snapshot->length()) {
+            return snapshot->at(index);
+        }
+        return ItemPtr();
+    }
     QMutexLocker l(&m_lock);
     if (index >= 0 && index < m_items.length()) {
         return m_items.at(index);
@@ -59,6 +78,20 @@ ItemPtr ItemContainer::item(int index) const
 }
 
 
+/**
+ * @brief Get the item with the given @p uid.
+ *
+ * This includes items which have been added but whose insertion has not
+ * been reported yet. Returns a null pointer if the container holds no item
+ * with this uid.
+ */
+ItemPtr ItemContainer::findItem(const QUuid& uid) const
+{
+    QMutexLocker l(&m_lock);
+    return m_uidMap.value(uid);
+}
+
+
 /**
  * @brief Get the item at the given @p index.
  *
@@ -83,7 +116,9 @@ Item *ItemContainer::get(int index) const
  * @note Insertion is done in a background thread. The signal
  * is fired delayed. This method has no effect if the them either
  * is a nullptr or the UID of the item already is known to the
- * container.
+ * container. The UID of the item is known to the container right
+ * when this method returns, so subsequent calls for items with the
+ * same UID are skipped, even if the insertion did not finish yet.
  *
  * @sa updateOrInsert()
  * @sa updateItem()
@@ -91,24 +126,67 @@ Item *ItemContainer::get(int index) const
 void ItemContainer::addItem(ItemPtr item)
 {
     QMutexLocker l(&m_lock);
-    if (!item.isNull() && !m_uidMap.contains(item->uid())) {
-        connect(item.data(), &Item::weightChanged,
-                this, static_cast<void(ItemContainer::*)()>(&ItemContainer::updateWeights));
+    if (acceptItem(item)) {
         QtConcurrent::run(m_threadPool, [=]() {
             QMutexLocker l(&m_lock);
-            connect(item.data(), &Item::itemDeleted, this, &ItemContainer::handleDeleteItem);
-            connect(item.data(), &Item::changed, this, &ItemContainer::handleItemChanged);
-            m_items.append(item);
-            m_uidMap.insert(item->uid(), item);
-            this->updateWeights(item.data());
-            QMetaObject::invokeMethod(
-                        this, "itemAdded",
-                        Qt::QueuedConnection,
-                        Q_ARG(int, m_items.length() - 1));
+            if (isAccepted(item)) {
+                appendItem(item);
+                QMetaObject::invokeMethod(
+                            this, "emitItemAdded",
+                            Qt::QueuedConnection,
+                            Q_ARG(int, prepareSnapshot()),
+                            Q_ARG(int, m_items.length() - 1));
+            }
         });
     }
 }
 
+/**
+ * @brief Add several items to the container.
+ *
+ * This adds the @p items to the container in one go. In contrast to
+ * calling addItem() for each of the items, the items are appended in a
+ * single background operation and the itemsAdded() signal is emitted
+ * only once for the whole range of new items.
+ *
+ * Null pointers and items whose UID already is known to the container
+ * (or which occurs more than once in @p items) are skipped. Returns the
+ * items which are added.
+ *
+ * @sa addItem()
+ */
+QList<ItemPtr> ItemContainer::addItems(const QList<ItemPtr> &items)
+{
+    QMutexLocker l(&m_lock);
+    QList<ItemPtr> newItems;
+    for (auto item : items) {
+        if (acceptItem(item)) {
+            newItems << item;
+        }
+    }
+    if (!newItems.isEmpty()) {
+        QtConcurrent::run(m_threadPool, [=]() {
+            QMutexLocker l(&m_lock);
+            int first = m_items.length();
+            for (auto item : newItems) {
+                if (isAccepted(item)) {
+                    appendItem(item);
+                }
+            }
+            int last = m_items.length() - 1;
+            if (last >= first) {
+                QMetaObject::invokeMethod(
+                            this, "emitItemsAdded",
+                            Qt::QueuedConnection,
+                            Q_ARG(int, prepareSnapshot()),
+                            Q_ARG(int, first),
+                            Q_ARG(int, last));
+            }
+        });
+    }
+    return newItems;
+}
+
 /**
  * @brief Update an item in the container.
  *
@@ -180,14 +258,57 @@ void ItemContainer::updateOrInsert(ItemPtr item)
     }
 }
 
+/**
+ * @brief Update or add several items.
+ *
+ * This works like updateOrInsert(), but all items which are not yet in the
+ * container are added using a single call to addItems(). If several of the
+ * @p items share the same UID, the first one is added and updated with
+ * the others. Returns the items which are added; these are exactly the
+ * items the container will hold once the insertion finished.
+ */
+QList<ItemPtr> ItemContainer::updateOrInsertItems(const QList<ItemPtr> &items)
+{
+    QList<ItemPtr> newItems;
+    QHash<QUuid, ItemPtr> newItemsByUid;
+    for (auto item : items) {
+        if (!item.isNull()) {
+            ItemPtr existingItem;
+            {
+                QMutexLocker l(&m_lock);
+                existingItem = m_uidMap.value(item->uid());
+            }
+            if (existingItem.isNull()) {
+                existingItem = newItemsByUid.value(item->uid());
+            }
+            if (existingItem.isNull()) {
+                newItems << item;
+                newItemsByUid.insert(item->uid(), item);
+            } else {
+                existingItem->fromVariant(item->toVariant());
+            }
+        }
+    }
+    return addItems(newItems);
+}
+
 /**
  * @brief Remove all items from the container.
+ *
+ * Snapshots of modifications which have not been reported yet are
+ * discarded, so the corresponding signals are not emitted any more.
  */
 void ItemContainer::clear()
 {
-    QMutexLocker l(&m_lock);
-    m_items.clear();
-    m_uidMap.clear();
+    {
+        QMutexLocker l(&m_lock);
+        m_items.clear();
+        m_uidMap.clear();
+        m_rowIndex.clear();
+        qDeleteAll(m_pendingSnapshots);
+        m_pendingSnapshots.clear();
+        delete m_snapshot.fetchAndStoreOrdered(new Snapshot());
+    }
     emit cleared();
 }
 
@@ -213,22 +334,17 @@ double ItemContainer::nextItemWeight() const
 void ItemContainer::handleDeleteItem(Item* item)
 {
     if (item != nullptr) {
+        auto uid = item->uid();
         QtConcurrent::run(m_threadPool, [=]() {
-            auto c = count();
-            for (int i = 0; i < c; ++i) {
-                m_lock.lock();
-                auto existingItem = m_items.at(i);
-                m_lock.unlock();
-                if (existingItem->uid() == item->uid()) {
-                    QMutexLocker l(&m_lock);
-                    m_items.removeAt(i);
-                    m_uidMap.remove(item->uid());
-                    QMetaObject::invokeMethod(
-                                this, "itemDeleted",
-                                Qt::QueuedConnection,
-                                Q_ARG(int, i));
-                    break;
-                }
+            QMutexLocker l(&m_lock);
+            auto index = indexOf(uid);
+            if (index >= 0) {
+                removeItemAt(index);
+                QMetaObject::invokeMethod(
+                            this, "emitItemDeleted",
+                            Qt::QueuedConnection,
+                            Q_ARG(int, prepareSnapshot()),
+                            Q_ARG(int, index));
             }
         });
     }
@@ -236,30 +352,190 @@ void ItemContainer::handleDeleteItem(Item* item)
 
 void ItemContainer::handleItemChanged()
 {
-    auto sender = this->sender();
-    Item* item = static_cast<Item*>(sender);
+    queueItemChanged(static_cast<Item*>(sender()), "emitItemChanged");
+}
+
+void ItemContainer::handleItemWeightChanged()
+{
+    queueItemChanged(static_cast<Item*>(sender()), "emitItemWeightChanged");
+}
+
+/**
+ * @brief Look up the row of the @p item and invoke the @p method with it.
+ *
+ * The lookup runs in the background; the @p method is invoked queued in the
+ * thread of the container.
+ */
+void ItemContainer::queueItemChanged(Item* item, const char* method)
+{
+    auto uid = item->uid();
     QtConcurrent::run(m_threadPool, [=]() {
         QMutexLocker l(&m_lock);
-        for (int i = 0; i < m_items.count(); ++i) {
-            auto it = m_items.at(i);
-            if (it.data() == item) {
-                QMetaObject::invokeMethod(
-                            this, "emitItemChanged",
-                            Qt::QueuedConnection,
-                            Q_ARG(int, i));
-                break;
-            }
+        auto index = indexOf(uid);
+        if (index >= 0 && m_items.at(index).data() == item) {
+            QMetaObject::invokeMethod(
+                        this, method,
+                        Qt::QueuedConnection,
+                        Q_ARG(int, index));
         }
     });
 }
 
+/**
+ * @brief Get the row of the item with the given @p uid.
+ *
+ * Returns -1 if no such item is in the container. Lookups are constant
+ * time: The row index is updated eagerly by removeItemAt(), which
+ * re-numbers the rows following the removed item. This is linear in the
+ * number of these rows, like removing the item from the list itself.
+ *
+ * @note The caller must hold the lock.
+ */
+int ItemContainer::indexOf(const QUuid& uid) const
+{
+    return m_rowIndex.value(uid, -1);
+}
+
+/**
+ * @brief Reserve the UID of the @p item for it.
+ *
+ * Returns true if the item is not null and its UID is not yet known to
+ * the container. In this case, the item must be appended by a background
+ * job afterwards.
+ *
+ * @note The caller must hold the lock.
+ */
+bool ItemContainer::acceptItem(ItemPtr item)
+{
+    if (item.isNull() || m_uidMap.contains(item->uid())) {
+        return false;
+    }
+    m_uidMap.insert(item->uid(), item);
+    connect(item.data(), &Item::weightChanged,
+            this, static_cast<void(ItemContainer::*)()>(&ItemContainer::updateWeights));
+    return true;
+}
+
+/**
+ * @brief Check if the accepted @p item still is to be appended.
+ *
+ * This is not the case if the container has been cleared since the item
+ * has been accepted.
+ *
+ * @note The caller must hold the lock.
+ */
+bool ItemContainer::isAccepted(ItemPtr item) const
+{
+    return m_uidMap.value(item->uid()) == item &&
+            !m_rowIndex.contains(item->uid());
+}
+
+/**
+ * @brief Append the @p item and update the indexes.
+ *
+ * @note The caller must hold the lock.
+ */
+void ItemContainer::appendItem(ItemPtr item)
+{
+    connect(item.data(), &Item::itemDeleted, this, &ItemContainer::handleDeleteItem);
+    connect(item.data(), &Item::changed, this, &ItemContainer::handleItemChanged);
+    connect(item.data(), &Item::weightChanged, this, &ItemContainer::handleItemWeightChanged);
+    auto uid = item->uid();
+    m_items.append(item);
+    m_rowIndex.insert(uid, m_items.length() - 1);
+    updateWeights(item.data());
+}
+
+/**
+ * @brief Remove the item at the @p index and update the indexes.
+ *
+ * @note The caller must hold the lock.
+ */
+void ItemContainer::removeItemAt(int index)
+{
+    auto uid = m_items.at(index)->uid();
+    m_items.removeAt(index);
+    m_uidMap.remove(uid);
+    m_rowIndex.remove(uid);
+    for (int i = index; i < m_items.length(); ++i) {
+        m_rowIndex[m_items.at(i)->uid()] = i;
+    }
+}
+
+/**
+ * @brief Record a snapshot of the current list of items.
+ *
+ * The snapshot is not visible to lock-free readers yet. Instead, the
+ * returned serial is passed to the slot reporting the modification, which
+ * installs the snapshot via installSnapshot() right before emitting the
+ * corresponding signal.
+ *
+ * @note The caller must hold the lock.
+ */
+int ItemContainer::prepareSnapshot()
+{
+    auto serial = ++m_snapshotSerial;
+    m_pendingSnapshots.insert(serial, new Snapshot(m_items));
+    return serial;
+}
+
+/**
+ * @brief Make the snapshot with the given @p serial available to lock-free readers.
+ *
+ * Returns false if the snapshot has been discarded in the meantime (i.e.
+ * because the container has been cleared). The previous snapshot is
+ * released right away: Lock-free reads only happen in the container's
+ * thread, which is busy running this method.
+ */
+bool ItemContainer::installSnapshot(int serial)
+{
+    const Snapshot *snapshot;
+    {
+        QMutexLocker l(&m_lock);
+        snapshot = m_pendingSnapshots.take(serial);
+    }
+    if (snapshot == nullptr) {
+        return false;
+    }
+    delete m_snapshot.fetchAndStoreOrdered(snapshot);
+    return true;
+}
+
+void ItemContainer::emitItemAdded(int serial, int index)
+{
+    if (installSnapshot(serial)) {
+        emit itemAdded(index);
+    }
+}
+
+void ItemContainer::emitItemsAdded(int serial, int first, int last)
+{
+    if (installSnapshot(serial)) {
+        emit itemsAdded(first, last);
+    }
+}
+
+void ItemContainer::emitItemDeleted(int serial, int index)
+{
+    if (installSnapshot(serial)) {
+        emit itemDeleted(index);
+    }
+}
+
 void ItemContainer::emitItemChanged(int index)
 {
-    if (index >= 0 && index < m_items.count()) {
+    if (index >= 0 && index < count()) {
         emit itemChanged(index);
     }
 }
 
+void ItemContainer::emitItemWeightChanged(int index)
+{
+    if (index >= 0 && index < count()) {
+        emit itemWeightChanged(index);
+    }
+}
+
 /**
  * @brief Update the @p item with the given @p data.
  */
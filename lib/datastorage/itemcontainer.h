@@ -1,6 +1,7 @@
 #ifndef ITEMCONTAINER_H
 #define ITEMCONTAINER_H
 
+#include <QAtomicPointer>
 #include <QObject>
 #include <QList>
 #include <QHash>
@@ -39,6 +40,17 @@ class QThreadPool;
  * auto anotherItem = loadItem();
  * c.updateItem(anotherItem);
  * @endcode
+ *
+ * Modifications are done by a background thread. After each modification,
+ * the container prepares an immutable snapshot of its items. Reading the
+ * items (via count() and item()) from the thread the container lives in
+ * uses the latest installed snapshot and does not need to take any lock.
+ * This keeps models (which read the items very often) free of lock
+ * contention. A snapshot is installed in the container's thread right
+ * before the signal reporting the modification is emitted. Hence, readers
+ * in that thread never see a modification before it has been reported
+ * (e.g. a model sees the new row count only after it began inserting
+ * the rows).
  */
 class ItemContainer : public QObject
 {
@@ -51,10 +63,13 @@ public:
     Q_INVOKABLE int count() const;
     ItemPtr item(int index) const;
     Q_INVOKABLE Item* get(int index) const;
+    ItemPtr findItem(const QUuid &uid) const;
     void addItem(ItemPtr item);
+    QList<ItemPtr> addItems(const QList<ItemPtr> &items);
     void updateItem(ItemPtr item);
     void deleteItem(ItemPtr item);
     void updateOrInsert(ItemPtr item);
+    QList<ItemPtr> updateOrInsertItems(const QList<ItemPtr> &items);
     void clear();
 
     double nextItemWeight() const;
@@ -66,6 +81,11 @@ signals:
      */
     void itemAdded(int index);
 
+    /**
+     * @brief The items in the range from @p first to @p last have been added.
+     */
+    void itemsAdded(int first, int last);
+
     /**
      * @brief An item has been removed at the given @p index.
      */
@@ -76,6 +96,13 @@ signals:
      */
     void itemChanged(int index);
 
+    /**
+     * @brief The weight of the item at the given @p index changed.
+     *
+     * This signal is emitted in addition to itemChanged().
+     */
+    void itemWeightChanged(int index);
+
     /**
      * @brief The container has been cleared.
      */
@@ -90,13 +117,28 @@ public slots:
 
 private:
 
+    typedef QList<ItemPtr> Snapshot;
+
     QList<ItemPtr>          m_items;
+    QAtomicPointer<const Snapshot> m_snapshot;
+    QHash<int, const Snapshot*> m_pendingSnapshots;
+    int                     m_snapshotSerial;
     QHash<QUuid, ItemPtr>   m_uidMap;
+    QHash<QUuid, int>       m_rowIndex;
     QThreadPool            *m_threadPool;
     mutable QMutex          m_lock;
     double                  m_minWeight;
     double                  m_maxWeight;
 
+    int indexOf(const QUuid &uid) const;
+    bool acceptItem(ItemPtr item);
+    bool isAccepted(ItemPtr item) const;
+    void appendItem(ItemPtr item);
+    void removeItemAt(int index);
+    int prepareSnapshot();
+    bool installSnapshot(int serial);
+    void queueItemChanged(Item *item, const char *method);
+
 private slots:
 
     void patchItem(ItemPtr item, QVariant data);
@@ -104,7 +146,12 @@ private slots:
     void updateWeights();
     void handleDeleteItem(Item* item);
     void handleItemChanged();
+    void handleItemWeightChanged();
+    void emitItemAdded(int serial, int index);
+    void emitItemsAdded(int serial, int first, int last);
+    void emitItemDeleted(int serial, int index);
     void emitItemChanged(int index);
+    void emitItemWeightChanged(int index);
 
 };
 
@@ -0,0 +1,1031 @@
+#include "itemrecordstore.h"
+
+#include <QDir>
+#include <QtConcurrent>
+
+#include "complexitem.h"
+#include "itemwriter.h"
+#include "library.h"
+#include "librarycache.h"
+#include "utils/jsonutils.h"
+
+
+Q_LOGGING_CATEGORY(itemRecordStore, "net.rpdev.opentodolist.ItemRecordStore", QtWarningMsg)
+
+
+/**
+ * @brief Constructor.
+ */
+ItemRecord::ItemRecord() :
+    uid(),
+    itemType(),
+    filename(),
+    title(),
+    weight(0.0),
+    done(false),
+    parentUid(),
+    tags()
+{
+}
+
+/**
+ * @brief Create a record from the properties of an item.
+ *
+ * The @p map holds the properties of the item as returned by Item::toMap(),
+ * the @p filename is the file the item is stored in.
+ */
+ItemRecord ItemRecord::fromMap(const QString& filename, const QVariantMap& map)
+{
+    ItemRecord result;
+    result.uid = map.value("uid").toUuid();
+    result.itemType = map.value("itemType").toString();
+    result.filename = filename;
+    result.title = map.value("title").toString();
+    result.weight = map.value("weight").toDouble();
+    result.done = map.value("done").toBool();
+    if (result.itemType == "Todo") {
+        result.parentUid = map.value("todoListUid").toUuid();
+    } else if (result.itemType == "Task") {
+        result.parentUid = map.value("todoUid").toUuid();
+    }
+    result.tags = map.value("tags").toStringList();
+    return result;
+}
+
+
+/**
+ * @brief Constructor.
+ */
+CompactItemRecord::CompactItemRecord() :
+    uid(),
+    parentUid(),
+    weight(0.0),
+    title(),
+    fileName(),
+    directory(0),
+    tagsOffset(0),
+    tagsCount(0),
+    itemType(0),
+    done(false)
+{
+}
+
+
+/**
+ * @brief Get the index of the @p value in the table of interned @p values.
+ *
+ * If the value is not yet in the table, it is appended.
+ */
+static quint32 intern(const QString &value, QStringList &values,
+                      QHash<QString, quint32> &index)
+{
+    auto it = index.constFind(value);
+    if (it != index.constEnd()) {
+        return it.value();
+    }
+    auto result = static_cast<quint32>(values.count());
+    values.append(value);
+    index.insert(value, result);
+    return result;
+}
+
+/**
+ * @brief Estimate the number of bytes allocated for the @p string.
+ */
+static int stringMemoryUsage(const QString &string)
+{
+    return static_cast<int>(sizeof(QString) + sizeof(QArrayData)) +
+            (string.capacity() + 1) * static_cast<int>(sizeof(QChar));
+}
+
+
+/**
+ * @brief The interned item types of todos and tasks.
+ *
+ * These are interned first, so the kind of a record can be determined
+ * without comparing strings.
+ */
+static const quint8 TodoItemType = 0;
+static const quint8 TaskItemType = 1;
+
+
+/**
+ * @brief The number of items which are kept in memory by default.
+ */
+const int ItemRecordStore::DefaultCacheSize = 256;
+
+
+/**
+ * @brief Constructor.
+ */
+ItemRecordStore::CacheEntry::CacheEntry() :
+    item(),
+    notes(),
+    notesLoaded(false),
+    position()
+{
+}
+
+
+/**
+ * @brief Constructor.
+ */
+ItemRecordStore::ItemRecordStore(QObject* parent) : QObject(parent),
+    m_records(),
+    m_strings(),
+    m_directories(),
+    m_directoryIndex(),
+    m_itemTypes(),
+    m_itemTypeIndex(),
+    m_tagNames(),
+    m_tagIndex(),
+    m_tags(),
+    m_unusedTags(0),
+    m_rowIndex(),
+    m_cache(),
+    m_recentlyUsed(),
+    m_usedSinceRelease(),
+    m_cacheSize(DefaultCacheSize),
+    m_releaseScheduled(false),
+    m_loadWatcher(nullptr),
+    m_library(),
+    m_pendingItems(),
+    m_pendingRemovedFiles()
+{
+    internItemTypes();
+    connect(this, &ItemRecordStore::recordsAdded,
+            this, &ItemRecordStore::countChanged);
+    connect(this, &ItemRecordStore::recordRemoved,
+            this, &ItemRecordStore::countChanged);
+    connect(this, &ItemRecordStore::cleared,
+            this, &ItemRecordStore::countChanged);
+}
+
+/**
+ * @brief Destructor.
+ */
+ItemRecordStore::~ItemRecordStore()
+{
+}
+
+/**
+ * @brief The number of records in the store.
+ */
+int ItemRecordStore::count() const
+{
+    return m_records.count();
+}
+
+/**
+ * @brief Get the record at the given @p index.
+ */
+ItemRecord ItemRecordStore::record(int index) const
+{
+    ItemRecord result;
+    if (index >= 0 && index < m_records.count()) {
+        const auto &record = m_records.at(index);
+        result.uid = record.uid;
+        result.itemType = m_itemTypes.at(static_cast<int>(record.itemType));
+        result.filename = filename(record);
+        result.title = m_strings.value(record.title);
+        result.weight = record.weight;
+        result.done = record.done;
+        result.parentUid = record.parentUid;
+        result.tags = tags(record);
+    }
+    return result;
+}
+
+/**
+ * @brief Get the index of the record with the given @p uid.
+ *
+ * Returns -1 if there is no such record.
+ */
+int ItemRecordStore::indexOf(const QUuid& uid) const
+{
+    return m_rowIndex.value(uid, -1);
+}
+
+/**
+ * @brief The uid of the record at the given @p index.
+ */
+QUuid ItemRecordStore::uid(int index) const
+{
+    if (index >= 0 && index < m_records.count()) {
+        return m_records.at(index).uid;
+    }
+    return QUuid();
+}
+
+/**
+ * @brief The item type of the record at the given @p index.
+ */
+QString ItemRecordStore::itemType(int index) const
+{
+    if (index >= 0 && index < m_records.count()) {
+        return m_itemTypes.at(static_cast<int>(m_records.at(index).itemType));
+    }
+    return QString();
+}
+
+/**
+ * @brief The kind of item of the record at the given @p index.
+ *
+ * Records which are neither todos nor tasks (including invalid ones) are
+ * reported as top level items.
+ */
+ItemRecordStore::RecordKind ItemRecordStore::kind(int index) const
+{
+    if (index >= 0 && index < m_records.count()) {
+        switch (m_records.at(index).itemType) {
+        case TodoItemType:
+            return TodoRecord;
+        case TaskItemType:
+            return TaskRecord;
+        default:
+            break;
+        }
+    }
+    return TopLevelRecord;
+}
+
+/**
+ * @brief The weight of the record at the given @p index.
+ */
+double ItemRecordStore::weight(int index) const
+{
+    if (index >= 0 && index < m_records.count()) {
+        return m_records.at(index).weight;
+    }
+    return 0.0;
+}
+
+/**
+ * @brief Indicates if the record at the given @p index is done.
+ */
+bool ItemRecordStore::done(int index) const
+{
+    if (index >= 0 && index < m_records.count()) {
+        return m_records.at(index).done;
+    }
+    return false;
+}
+
+/**
+ * @brief The uid of the parent of the record at the given @p index.
+ *
+ * This is the uid of the todo list of a todo and the uid of the todo of a
+ * task.
+ */
+QUuid ItemRecordStore::parentUid(int index) const
+{
+    if (index >= 0 && index < m_records.count()) {
+        return m_records.at(index).parentUid;
+    }
+    return QUuid();
+}
+
+/**
+ * @brief The tags of the record at the given @p index.
+ */
+QStringList ItemRecordStore::tags(int index) const
+{
+    if (index >= 0 && index < m_records.count()) {
+        return tags(m_records.at(index));
+    }
+    return QStringList();
+}
+
+/**
+ * @brief Get the notes of the item at the given @p index.
+ *
+ * Notes can be long and are only needed when an item is shown in detail,
+ * so they are not part of the records. Instead, they are taken from the
+ * item if it has been created or read from its file otherwise. Notes read
+ * from files are cached like items, until the item changes or is released.
+ */
+QString ItemRecordStore::notes(int index)
+{
+    if (index < 0 || index >= m_records.count()) {
+        return QString();
+    }
+    const auto &record = m_records.at(index);
+    auto &entry = useCacheEntry(record.uid);
+    auto item = m_library.isNull() ? entry.item : libraryItem(record.uid);
+    auto complexItem = qobject_cast<ComplexItem*>(item.data());
+    if (complexItem != nullptr) {
+        return complexItem->notes();
+    }
+    if (!entry.notesLoaded) {
+        auto path = filename(record);
+        ItemWriter::instance()->flush(path);
+        entry.notes = JsonUtils::loadMap(path).value("notes").toString();
+        entry.notesLoaded = true;
+    }
+    return entry.notes;
+}
+
+/**
+ * @brief Append the @p records to the store.
+ *
+ * Records whose uid already is in the store are skipped.
+ */
+void ItemRecordStore::addRecords(const QVector<ItemRecord>& records)
+{
+    int first = m_records.count();
+    m_records.reserve(first + records.count());
+    for (const auto &record : records) {
+        if (!record.uid.isNull() && !m_rowIndex.contains(record.uid)) {
+            CompactItemRecord compact;
+            setRecord(compact, record);
+            m_rowIndex.insert(record.uid, m_records.count());
+            m_records.append(compact);
+        }
+    }
+    if (m_records.count() > first) {
+        emit recordsAdded(first, m_records.count() - 1);
+    }
+}
+
+/**
+ * @brief Remove all records and release all items.
+ */
+void ItemRecordStore::clear()
+{
+    for (const auto &entry : m_cache) {
+        if (!entry.item.isNull()) {
+            disconnect(entry.item.data(), nullptr, this, nullptr);
+        }
+    }
+    m_cache.clear();
+    m_recentlyUsed.clear();
+    m_usedSinceRelease.clear();
+    m_records.clear();
+    m_strings.clear();
+    m_directories.clear();
+    m_directoryIndex.clear();
+    m_itemTypes.clear();
+    m_itemTypeIndex.clear();
+    internItemTypes();
+    m_tagNames.clear();
+    m_tagIndex.clear();
+    m_tags.clear();
+    m_unusedTags = 0;
+    m_rowIndex.clear();
+    emit cleared();
+}
+
+/**
+ * @brief Get the item of the record at the given @p index.
+ *
+ * If a library is set, its instance of the item is returned. There must
+ * not be a second instance of an item of the library: Changes made to it
+ * would not reach the library and be overwritten when the library saves
+ * its instance the next time. The pointer is null if the library did not
+ * load the item yet; recordChanged() is emitted once it did.
+ *
+ * Otherwise, if the item has not been created yet (or has been released in
+ * the meantime), it is loaded from its file. Any pending writes for the file
+ * are flushed before, so changes made to a previously released item are not
+ * lost. Returns a null pointer if the index is out of range or the item
+ * cannot be loaded.
+ *
+ * If the cache is full, releasing items is scheduled, but no item is released
+ * right away. It is hence safe to call this method from within
+ * QAbstractItemModel::data().
+ */
+ItemPtr ItemRecordStore::item(int index)
+{
+    if (index < 0 || index >= m_records.count()) {
+        return ItemPtr();
+    }
+    const auto &record = m_records.at(index);
+    if (!m_library.isNull()) {
+        return libraryItem(record.uid);
+    }
+    auto result = m_cache.value(record.uid).item;
+    if (result.isNull()) {
+        auto path = filename(record);
+        ItemWriter::instance()->flush(path);
+        auto item = Item::createItemFromFile(path);
+        if (item == nullptr) {
+            qCWarning(itemRecordStore) << "Failed to load item from" << path;
+            return ItemPtr();
+        }
+        // Note: Views might still refer to a released item until they
+        // handled the itemReleased() signal, so delete it delayed.
+        result = ItemPtr(item, &QObject::deleteLater);
+        watchItem(item);
+    }
+    useCacheEntry(record.uid).item = result;
+    return result;
+}
+
+/**
+ * @brief The number of items which currently are kept in memory.
+ */
+int ItemRecordStore::materializedCount() const
+{
+    int result = 0;
+    for (const auto &entry : m_cache) {
+        if (!entry.item.isNull()) {
+            ++result;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief The maximum number of items which are kept in memory.
+ *
+ * This should be larger than the number of rows a view shows at once.
+ */
+int ItemRecordStore::cacheSize() const
+{
+    return m_cacheSize;
+}
+
+/**
+ * @brief Set the maximum number of items which are kept in memory.
+ */
+void ItemRecordStore::setCacheSize(int cacheSize)
+{
+    cacheSize = qMax(cacheSize, 1);
+    if (m_cacheSize != cacheSize) {
+        m_cacheSize = cacheSize;
+        emit cacheSizeChanged();
+        scheduleRelease();
+    }
+}
+
+/**
+ * @brief Indicates if the store currently loads records.
+ */
+bool ItemRecordStore::loading() const
+{
+    return m_loadWatcher != nullptr;
+}
+
+/**
+ * @brief The library the store follows.
+ */
+Library* ItemRecordStore::library() const
+{
+    return m_library.data();
+}
+
+/**
+ * @brief Set the @p library the store follows.
+ *
+ * The records of the items in the library are loaded and from then on
+ * updated when items are added to the library, changed or deleted and when
+ * files of items are removed from the library directory. Items loaded
+ * from added or modified files reach the store via the library.
+ *
+ * Setting a null library clears the store.
+ */
+void ItemRecordStore::setLibrary(Library* library)
+{
+    if (m_library == library) {
+        return;
+    }
+    if (!m_library.isNull()) {
+        disconnect(m_library.data(), nullptr, this, nullptr);
+        for (auto container : {m_library->topLevelItems(), m_library->todos(),
+                               m_library->tasks()}) {
+            for (int i = 0; i < container->count(); ++i) {
+                auto item = container->item(i);
+                if (!item.isNull()) {
+                    disconnect(item.data(), nullptr, this, nullptr);
+                }
+            }
+        }
+    }
+    m_library = library;
+    m_pendingItems.clear();
+    m_pendingRemovedFiles.clear();
+    if (library != nullptr) {
+        connect(library, &Library::itemsAdded,
+                this, &ItemRecordStore::handleItemsAdded);
+        connect(library, &Library::filesChanged,
+                this, &ItemRecordStore::handleFilesChanged);
+        // Items created by the store before must not live on next to the
+        // ones of the library:
+        clear();
+        if (library->isValid()) {
+            load(library->directory());
+        }
+        QList<ItemPtr> items;
+        for (auto container : {library->topLevelItems(), library->todos(),
+                               library->tasks()}) {
+            for (int i = 0; i < container->count(); ++i) {
+                auto item = container->item(i);
+                if (!item.isNull()) {
+                    items << item;
+                }
+            }
+        }
+        handleItemsAdded(items);
+    } else {
+        if (loading()) {
+            m_loadWatcher = nullptr;
+            emit loadingChanged();
+        }
+        clear();
+    }
+    emit libraryChanged();
+}
+
+/**
+ * @brief Estimate the number of bytes used to store the records.
+ *
+ * This includes the records, the strings they refer to and the lookup
+ * tables of the store. Items which have been created via item() are not
+ * included.
+ */
+int ItemRecordStore::memoryUsage() const
+{
+    const int hashNode = 2 * static_cast<int>(sizeof(void*));
+    int result = static_cast<int>(sizeof(ItemRecordStore));
+    result += m_records.capacity() * static_cast<int>(sizeof(CompactItemRecord));
+    result += m_strings.memoryUsage();
+    result += m_tags.capacity() * static_cast<int>(sizeof(quint32));
+    for (auto values : {&m_directories, &m_itemTypes, &m_tagNames}) {
+        for (const auto &value : *values) {
+            // The string data is shared between the list and the hash:
+            result += stringMemoryUsage(value) + static_cast<int>(
+                        sizeof(QString) + sizeof(quint32)) + hashNode;
+        }
+    }
+    result += m_rowIndex.count() * (static_cast<int>(
+                                        sizeof(QUuid) + sizeof(int)) + hashNode);
+    return result;
+}
+
+/**
+ * @brief Read the records of all items in the library @p directory.
+ *
+ * Like the LibraryLoader, this uses the library cache and only parses the
+ * files of items which changed since the cache has been written. No Item
+ * objects are created.
+ */
+QVector<ItemRecord> ItemRecordStore::loadRecords(const QString& directory)
+{
+    QVector<ItemRecord> result;
+    LibraryCache cache(directory);
+    cache.load();
+    QDir root(directory);
+    QString suffix = "*." + Item::FileNameSuffix;
+    for (auto year : Library::years(directory)) {
+        for (auto month : Library::months(directory, year)) {
+            QDir dir(directory + "/" + year + "/" + month);
+            for (auto fileInfo : dir.entryInfoList({suffix}, QDir::Files)) {
+                auto path = root.relativeFilePath(fileInfo.absoluteFilePath());
+                QVariantMap data;
+                if (!cache.lookup(path, fileInfo, &data)) {
+                    bool ok;
+                    data = JsonUtils::loadMap(fileInfo.absoluteFilePath(), &ok);
+                    if (!ok) {
+                        continue;
+                    }
+                    cache.insert(path, fileInfo, data);
+                }
+                result << ItemRecord::fromMap(fileInfo.absoluteFilePath(), data);
+            }
+        }
+    }
+    cache.removeUnused();
+    if (cache.isModified()) {
+        cache.save();
+    }
+    return result;
+}
+
+/**
+ * @brief Load the records of the items in the library @p directory.
+ *
+ * The records are read in a background thread. Once done, they replace the
+ * current contents of the store.
+ */
+void ItemRecordStore::load(const QString& directory)
+{
+    bool wasLoading = loading();
+    auto watcher = new QFutureWatcher<QVector<ItemRecord>>(this);
+    connect(watcher, &QFutureWatcher<QVector<ItemRecord>>::finished,
+            this, &ItemRecordStore::handleLoadFinished);
+    m_loadWatcher = watcher;
+    watcher->setFuture(QtConcurrent::run(&ItemRecordStore::loadRecords, directory));
+    if (!wasLoading) {
+        emit loadingChanged();
+    }
+}
+
+/**
+ * @brief The full path to the file of the @p record.
+ */
+QString ItemRecordStore::filename(const CompactItemRecord& record) const
+{
+    return m_directories.at(static_cast<int>(record.directory)) +
+            m_strings.value(record.fileName);
+}
+
+/**
+ * @brief The tags of the @p record.
+ */
+QStringList ItemRecordStore::tags(const CompactItemRecord& record) const
+{
+    QStringList result;
+    result.reserve(record.tagsCount);
+    for (int i = 0; i < record.tagsCount; ++i) {
+        auto tag = m_tags.at(static_cast<int>(record.tagsOffset) + i);
+        result << m_tagNames.at(static_cast<int>(tag));
+    }
+    return result;
+}
+
+/**
+ * @brief Store the properties of the @p record in @p compact.
+ *
+ * Strings which did not change are kept, so updating a record does not
+ * grow the string arena unless the title or file actually changed.
+ */
+void ItemRecordStore::setRecord(CompactItemRecord& compact, const ItemRecord& record)
+{
+    compact.uid = record.uid;
+    compact.parentUid = record.parentUid;
+    compact.weight = record.weight;
+    compact.done = record.done;
+    compact.itemType = static_cast<quint8>(
+                intern(record.itemType, m_itemTypes, m_itemTypeIndex));
+
+    // Split the path after the last separator, so the directory part
+    // (which is shared by many items) can be interned:
+    int split = record.filename.lastIndexOf('/') + 1;
+    compact.directory = intern(record.filename.left(split),
+                               m_directories, m_directoryIndex);
+    auto fileName = record.filename.mid(split);
+    if (!m_strings.equals(compact.fileName, fileName)) {
+        m_strings.release(compact.fileName);
+        compact.fileName = m_strings.insert(fileName);
+    }
+    if (!m_strings.equals(compact.title, record.title)) {
+        m_strings.release(compact.title);
+        compact.title = m_strings.insert(record.title);
+    }
+
+    if (tags(compact) != record.tags) {
+        m_unusedTags += compact.tagsCount;
+        compact.tagsOffset = static_cast<quint32>(m_tags.count());
+        compact.tagsCount = static_cast<quint16>(record.tags.count());
+        for (const auto &tag : record.tags) {
+            m_tags.append(intern(tag, m_tagNames, m_tagIndex));
+        }
+    }
+}
+
+/**
+ * @brief Mark the strings and tags of the @p record as unused.
+ */
+void ItemRecordStore::releaseRecord(const CompactItemRecord& record)
+{
+    m_strings.release(record.title);
+    m_strings.release(record.fileName);
+    m_unusedTags += record.tagsCount;
+}
+
+/**
+ * @brief Get the library's instance of the item with the given @p uid.
+ */
+ItemPtr ItemRecordStore::libraryItem(const QUuid& uid) const
+{
+    for (auto container : {m_library->topLevelItems(), m_library->todos(),
+                           m_library->tasks()}) {
+        auto result = container->findItem(uid);
+        if (!result.isNull()) {
+            return result;
+        }
+    }
+    return ItemPtr();
+}
+
+/**
+ * @brief Remove the record at the given @p index.
+ *
+ * If the item of the record has been created, it is released.
+ */
+void ItemRecordStore::removeRecord(int index)
+{
+    removeRecords({index});
+}
+
+/**
+ * @brief Remove the records at the given @p indexes.
+ *
+ * The @p indexes must be sorted in ascending order. The records are
+ * removed in a single sweep, which renumbers the rows following the first
+ * removed one only once. recordRemoved() is emitted for the records in
+ * descending order, so each index refers to the rows before the removal
+ * of the record.
+ */
+void ItemRecordStore::removeRecords(const QVector<int>& indexes)
+{
+    if (indexes.isEmpty()) {
+        return;
+    }
+    int next = 0;
+    int write = indexes.first();
+    for (int read = write; read < m_records.count(); ++read) {
+        auto record = m_records.at(read);
+        if (next < indexes.count() && indexes.at(next) == read) {
+            ++next;
+            removeCacheEntry(record.uid);
+            releaseRecord(record);
+            m_rowIndex.remove(record.uid);
+        } else {
+            m_rowIndex[record.uid] = write;
+            if (write != read) {
+                m_records[write] = record;
+            }
+            ++write;
+        }
+    }
+    m_records.resize(write);
+    compact();
+    for (int i = indexes.count() - 1; i >= 0; --i) {
+        emit recordRemoved(indexes.at(i));
+    }
+}
+
+/**
+ * @brief Update the records when the @p item changes or is deleted.
+ */
+void ItemRecordStore::watchItem(Item* item)
+{
+    connect(item, &Item::changed, this, &ItemRecordStore::handleItemChanged);
+    connect(item, &Item::itemDeleted, this, &ItemRecordStore::handleItemDeleted);
+}
+
+/**
+ * @brief Add records for the @p items.
+ *
+ * If there already is a record for an item, it is updated instead: The
+ * record might have been read from the file of the item before the item
+ * was saved the last time.
+ */
+void ItemRecordStore::addItems(const QList<ItemPtr>& items)
+{
+    QVector<ItemRecord> records;
+    records.reserve(items.count());
+    for (auto item : items) {
+        auto data = item->toVariant().toMap().value("data").toMap();
+        auto record = ItemRecord::fromMap(item->filename(), data);
+        auto index = indexOf(record.uid);
+        if (index >= 0) {
+            setRecord(m_records[index], record);
+            auto entry = m_cache.find(record.uid);
+            if (entry != m_cache.end()) {
+                entry->notes.clear();
+                entry->notesLoaded = false;
+            }
+            emit recordChanged(index);
+        } else {
+            records << record;
+        }
+    }
+    compact();
+    addRecords(records);
+}
+
+/**
+ * @brief Remove the records of the items stored in the @p files.
+ *
+ * The records are searched in a single pass, looking up the file names only
+ * for records in the directories of the files. All matching records are
+ * then removed at once.
+ */
+void ItemRecordStore::removeFiles(const QStringList& files)
+{
+    auto suffix = "." + Item::FileNameSuffix;
+    QHash<quint32, QSet<QString>> removed;
+    for (const auto &file : files) {
+        if (file.endsWith(suffix)) {
+            int split = file.lastIndexOf('/') + 1;
+            auto it = m_directoryIndex.constFind(file.left(split));
+            if (it != m_directoryIndex.constEnd()) {
+                removed[it.value()].insert(file.mid(split));
+            }
+        }
+    }
+    if (removed.isEmpty()) {
+        return;
+    }
+    QVector<int> indexes;
+    for (int i = 0; i < m_records.count(); ++i) {
+        const auto &record = m_records.at(i);
+        auto it = removed.constFind(record.directory);
+        if (it != removed.constEnd() &&
+                it.value().contains(m_strings.value(record.fileName))) {
+            indexes << i;
+        }
+    }
+    removeRecords(indexes);
+}
+
+/**
+ * @brief Drop unused strings and tags if they take up too much space.
+ *
+ * Updating and removing records leaves unused data behind in the string
+ * arena and the tag list. Once more than half of it is unused, both are
+ * rebuilt from the records.
+ */
+void ItemRecordStore::compact()
+{
+    const int MinimumSize = 4096;
+    bool compactStrings = m_strings.size() > MinimumSize &&
+            m_strings.unused() > m_strings.size() / 2;
+    bool compactTags = m_tags.count() > MinimumSize &&
+            m_unusedTags > m_tags.count() / 2;
+    if (!compactStrings && !compactTags) {
+        return;
+    }
+    StringArena strings;
+    QVector<quint32> tags;
+    if (compactTags) {
+        tags.reserve(m_tags.count() - m_unusedTags);
+    }
+    for (auto &record : m_records) {
+        if (compactStrings) {
+            auto title = m_strings.value(record.title);
+            auto fileName = m_strings.value(record.fileName);
+            record.title = strings.insert(title);
+            record.fileName = strings.insert(fileName);
+        }
+        if (compactTags) {
+            auto offset = static_cast<quint32>(tags.count());
+            tags += m_tags.mid(static_cast<int>(record.tagsOffset),
+                               record.tagsCount);
+            record.tagsOffset = offset;
+        }
+    }
+    if (compactStrings) {
+        strings.squeeze();
+        m_strings = strings;
+    }
+    if (compactTags) {
+        m_tags = tags;
+        m_unusedTags = 0;
+    }
+}
+
+/**
+ * @brief Intern the item types of todos and tasks.
+ *
+ * This must be done before any record is stored, so they get the indexes
+ * kind() relies on.
+ */
+void ItemRecordStore::internItemTypes()
+{
+    auto todo = intern("Todo", m_itemTypes, m_itemTypeIndex);
+    auto task = intern("Task", m_itemTypes, m_itemTypeIndex);
+    Q_ASSERT(todo == TodoItemType);
+    Q_ASSERT(task == TaskItemType);
+    Q_UNUSED(todo);
+    Q_UNUSED(task);
+}
+
+/**
+ * @brief Get the cache entry for the @p uid and mark it as recently used.
+ *
+ * The entry is created if there is none yet. Releasing entries is
+ * scheduled if needed.
+ */
+ItemRecordStore::CacheEntry& ItemRecordStore::useCacheEntry(const QUuid& uid)
+{
+    auto it = m_cache.find(uid);
+    if (it == m_cache.end()) {
+        it = m_cache.insert(uid, CacheEntry());
+        it->position = m_recentlyUsed.insert(m_recentlyUsed.end(), uid);
+    } else {
+        m_recentlyUsed.splice(m_recentlyUsed.end(), m_recentlyUsed, it->position);
+    }
+    m_usedSinceRelease.insert(uid);
+    scheduleRelease();
+    return it.value();
+}
+
+/**
+ * @brief Remove the cache entry for the @p uid, if any.
+ */
+void ItemRecordStore::removeCacheEntry(const QUuid& uid)
+{
+    auto it = m_cache.find(uid);
+    if (it != m_cache.end()) {
+        if (!it->item.isNull()) {
+            disconnect(it->item.data(), nullptr, this, nullptr);
+        }
+        m_recentlyUsed.erase(it->position);
+        m_cache.erase(it);
+    }
+    m_usedSinceRelease.remove(uid);
+}
+
+/**
+ * @brief Release items once control returns to the event loop.
+ */
+void ItemRecordStore::scheduleRelease()
+{
+    if (!m_releaseScheduled) {
+        m_releaseScheduled = true;
+        QMetaObject::invokeMethod(this, "releaseItems", Qt::QueuedConnection);
+    }
+}
+
+/**
+ * @brief Release the least recently used items until the cache size is met.
+ *
+ * Items which have been requested since this method ran the last time are
+ * kept: They most likely are shown by a view right now.
+ */
+void ItemRecordStore::releaseItems()
+{
+    m_releaseScheduled = false;
+    while (m_cache.count() > m_cacheSize &&
+           !m_usedSinceRelease.contains(m_recentlyUsed.front())) {
+        auto uid = m_recentlyUsed.front();
+        m_recentlyUsed.pop_front();
+        auto item = m_cache.take(uid).item;
+        if (!item.isNull()) {
+            disconnect(item.data(), nullptr, this, nullptr);
+            auto index = indexOf(uid);
+            if (index >= 0) {
+                emit itemReleased(index);
+            }
+        }
+    }
+    m_usedSinceRelease.clear();
+}
+
+void ItemRecordStore::handleItemChanged()
+{
+    auto item = static_cast<Item*>(sender());
+    auto index = indexOf(item->uid());
+    if (index >= 0) {
+        auto data = item->toVariant().toMap().value("data").toMap();
+        setRecord(m_records[index], ItemRecord::fromMap(item->filename(), data));
+        compact();
+        emit recordChanged(index);
+
+        auto entry = m_cache.find(item->uid());
+        if (entry != m_cache.end()) {
+            entry->notes.clear();
+            entry->notesLoaded = false;
+        }
+    }
+}
+
+void ItemRecordStore::handleItemDeleted(Item* item)
+{
+    disconnect(item, nullptr, this, nullptr);
+    auto index = indexOf(item->uid());
+    if (index >= 0) {
+        removeRecord(index);
+    }
+}
+
+void ItemRecordStore::handleLoadFinished()
+{
+    auto watcher = static_cast<QFutureWatcher<QVector<ItemRecord>>*>(sender());
+    if (watcher == m_loadWatcher) {
+        m_loadWatcher = nullptr;
+        clear();
+        addRecords(watcher->result());
+        addItems(m_pendingItems);
+        removeFiles(m_pendingRemovedFiles);
+        m_pendingItems.clear();
+        m_pendingRemovedFiles.clear();
+        emit loadingChanged();
+    }
+    watcher->deleteLater();
+}
+
+void ItemRecordStore::handleItemsAdded(const QList<ItemPtr>& items)
+{
+    for (auto item : items) {
+        watchItem(item.data());
+    }
+    if (loading()) {
+        // The records would be dropped once loading finished:
+        m_pendingItems += items;
+    } else {
+        addItems(items);
+    }
+}
+
+void ItemRecordStore::handleFilesChanged(const FileChangeSet& changes)
+{
+    if (loading()) {
+        m_pendingRemovedFiles += changes.removed;
+    } else {
+        removeFiles(changes.removed);
+    }
+}
@@ -0,0 +1,270 @@
+#ifndef ITEMRECORDSTORE_H
+#define ITEMRECORDSTORE_H
+
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QLoggingCategory>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QUuid>
+#include <QVariantMap>
+#include <QVector>
+
+#include <list>
+
+#include "item.h"
+#include "stringarena.h"
+#include "utils/directorywatcher.h"
+
+
+class Library;
+
+/**
+ * @brief A lightweight description of an item.
+ *
+ * An ItemRecord holds the properties of an item which are needed to show it
+ * in a list and to filter and sort it. In contrast to Item objects, records
+ * are plain values: they are cheap to create and do not need any signal
+ * connections.
+ */
+struct ItemRecord {
+    QUuid       uid;
+    QString     itemType;
+    QString     filename;
+    QString     title;
+    double      weight;
+    bool        done;
+    QUuid       parentUid;
+    QStringList tags;
+
+    ItemRecord();
+
+    static ItemRecord fromMap(const QString &filename, const QVariantMap &map);
+};
+
+Q_DECLARE_TYPEINFO(ItemRecord, Q_MOVABLE_TYPE);
+
+
+/**
+ * @brief The compact in-memory representation of an ItemRecord.
+ *
+ * This is used internally by the ItemRecordStore. The title and file name
+ * are stored in the string arena of the store. The directory, item type and
+ * tags are indexes into tables of interned values, so e.g. the directory
+ * path is stored only once for all items in it.
+ */
+struct CompactItemRecord {
+    QUuid               uid;
+    QUuid               parentUid;
+    double              weight;
+    StringArena::Ref    title;
+    StringArena::Ref    fileName;
+    quint32             directory;
+    quint32             tagsOffset;
+    quint16             tagsCount;
+    quint8              itemType;
+    bool                done;
+
+    CompactItemRecord();
+};
+
+Q_DECLARE_TYPEINFO(CompactItemRecord, Q_MOVABLE_TYPE);
+
+
+/**
+ * @brief A store of item records with lazily created items.
+ *
+ * The ItemRecordStore holds an ItemRecord for each item in a library. This
+ * allows to show very large libraries without creating an Item object for
+ * each of the items up front. Items are only created when they are
+ * requested via item(), e.g. when a view shows the row of an item or the
+ * user opens it for editing.
+ *
+ * Created items are kept in a cache of limited size. If the cache is full,
+ * the least recently used items are released and itemReleased() is emitted
+ * for them. Releasing is deferred until control returns to the event loop,
+ * so requesting an item (e.g. from QAbstractItemModel::data()) never causes
+ * signals to be emitted synchronously. Items which have been requested since
+ * the last time items were released are kept, even if this exceeds the cache
+ * size. This way, a view showing more rows than the cache can hold does not
+ * keep releasing and re-creating the items it shows. Changes to created
+ * items are reflected in their records.
+ *
+ * If a library is set, the store loads the records of the items in it and
+ * follows its changes: Items added to the library, changes of its items and
+ * items deleted from it or whose files have been removed are reflected in
+ * the records. In this case, item() returns the items of the library
+ * instead of creating items itself.
+ *
+ * Records are stored in a compact form (see CompactItemRecord) to keep the
+ * memory required per item low. Use the accessors for single properties
+ * (e.g. weight()) to read a property without creating an ItemRecord. The
+ * notes of items are not part of the records; use notes() to read them on
+ * demand. They are cached along with the items.
+ *
+ * @note The store is not thread safe; use it from the thread it lives in
+ * only.
+ */
+class ItemRecordStore : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+    Q_PROPERTY(int cacheSize READ cacheSize WRITE setCacheSize NOTIFY cacheSizeChanged)
+    Q_PROPERTY(bool loading READ loading NOTIFY loadingChanged)
+    Q_PROPERTY(Library* library READ library WRITE setLibrary NOTIFY libraryChanged)
+public:
+
+    /**
+     * @brief The kinds of items distinguished by the store.
+     */
+    enum RecordKind {
+        TopLevelRecord,
+        TodoRecord,
+        TaskRecord
+    };
+
+    static const int DefaultCacheSize;
+
+    explicit ItemRecordStore(QObject *parent = nullptr);
+    virtual ~ItemRecordStore();
+
+    int count() const;
+    ItemRecord record(int index) const;
+    int indexOf(const QUuid &uid) const;
+    QUuid uid(int index) const;
+    QString itemType(int index) const;
+    RecordKind kind(int index) const;
+    double weight(int index) const;
+    bool done(int index) const;
+    QUuid parentUid(int index) const;
+    QStringList tags(int index) const;
+    QString notes(int index);
+    void addRecords(const QVector<ItemRecord> &records);
+    void clear();
+
+    ItemPtr item(int index);
+    int materializedCount() const;
+
+    int cacheSize() const;
+    void setCacheSize(int cacheSize);
+
+    bool loading() const;
+
+    Library *library() const;
+    void setLibrary(Library *library);
+
+    int memoryUsage() const;
+
+    static QVector<ItemRecord> loadRecords(const QString &directory);
+
+signals:
+
+    /**
+     * @brief The records in the range from @p first to @p last have been added.
+     */
+    void recordsAdded(int first, int last);
+
+    /**
+     * @brief The record at the given @p index has been removed.
+     *
+     * This happens if the item of the record is deleted.
+     */
+    void recordRemoved(int index);
+
+    /**
+     * @brief The record at the given @p index changed.
+     */
+    void recordChanged(int index);
+
+    /**
+     * @brief The item of the record at the given @p index has been released.
+     *
+     * Any pointer to the item obtained before becomes invalid once control
+     * returns to the event loop.
+     */
+    void itemReleased(int index);
+
+    /**
+     * @brief The store has been cleared.
+     */
+    void cleared();
+
+    void countChanged();
+    void cacheSizeChanged();
+    void loadingChanged();
+    void libraryChanged();
+
+public slots:
+
+    void load(const QString &directory);
+
+private:
+
+    /**
+     * @brief An entry in the cache of items and notes.
+     */
+    struct CacheEntry {
+        ItemPtr                     item;
+        QString                     notes;
+        bool                        notesLoaded;
+        std::list<QUuid>::iterator  position;
+
+        CacheEntry();
+    };
+
+    QVector<CompactItemRecord>  m_records;
+    StringArena             m_strings;
+    QStringList             m_directories;
+    QHash<QString, quint32> m_directoryIndex;
+    QStringList             m_itemTypes;
+    QHash<QString, quint32> m_itemTypeIndex;
+    QStringList             m_tagNames;
+    QHash<QString, quint32> m_tagIndex;
+    QVector<quint32>        m_tags;
+    int                     m_unusedTags;
+    QHash<QUuid, int>       m_rowIndex;
+    QHash<QUuid, CacheEntry> m_cache;
+    std::list<QUuid>        m_recentlyUsed;
+    QSet<QUuid>             m_usedSinceRelease;
+    int                     m_cacheSize;
+    bool                    m_releaseScheduled;
+    QFutureWatcher<QVector<ItemRecord>> *m_loadWatcher;
+    QPointer<Library>       m_library;
+    QList<ItemPtr>          m_pendingItems;
+    QStringList             m_pendingRemovedFiles;
+
+    void internItemTypes();
+    CacheEntry &useCacheEntry(const QUuid &uid);
+    void removeCacheEntry(const QUuid &uid);
+    void scheduleRelease();
+    QString filename(const CompactItemRecord &record) const;
+    QStringList tags(const CompactItemRecord &record) const;
+    void setRecord(CompactItemRecord &compact, const ItemRecord &record);
+    void releaseRecord(const CompactItemRecord &record);
+    ItemPtr libraryItem(const QUuid &uid) const;
+    void removeRecord(int index);
+    void removeRecords(const QVector<int> &indexes);
+    void watchItem(Item *item);
+    void addItems(const QList<ItemPtr> &items);
+    void removeFiles(const QStringList &files);
+    void compact();
+
+private slots:
+
+    void releaseItems();
+    void handleItemChanged();
+    void handleItemDeleted(Item *item);
+    void handleLoadFinished();
+    void handleItemsAdded(const QList<ItemPtr> &items);
+    void handleFilesChanged(const FileChangeSet &changes);
+
+};
+
+
+Q_DECLARE_LOGGING_CATEGORY(itemRecordStore)
+
+#endif // ITEMRECORDSTORE_H
@@ -0,0 +1,233 @@
+#include "itemwriter.h"
+
+#include <QMutexLocker>
+#include <QtConcurrent>
+
+
+Q_LOGGING_CATEGORY(itemWriter, "net.rpdev.opentodolist.ItemWriter", QtWarningMsg)
+
+Q_GLOBAL_STATIC(ItemWriter, globalItemWriter)
+
+
+/**
+ * @brief The default interval (in milliseconds) before pending writes are flushed.
+ */
+const int ItemWriter::DefaultDelay = 500;
+
+
+/**
+ * @brief Constructor.
+ */
+ItemWriter::ItemWriter() :
+    m_pending(),
+    m_threadPool(),
+    m_lock(),
+    m_writeLock(),
+    m_wakeUp(),
+    m_scheduled(false),
+    m_stopping(false),
+    m_delay(DefaultDelay)
+{
+    m_threadPool.setMaxThreadCount(1);
+}
+
+
+/**
+ * @brief Destructor.
+ *
+ * Waits for any running batch to finish and writes remaining changes.
+ */
+ItemWriter::~ItemWriter()
+{
+    {
+        QMutexLocker l(&m_lock);
+        m_stopping = true;
+        m_wakeUp.wakeAll();
+    }
+    m_threadPool.waitForDone();
+    flush();
+}
+
+
+/**
+ * @brief The application wide item writer instance.
+ */
+ItemWriter *ItemWriter::instance()
+{
+    return globalItemWriter;
+}
+
+
+/**
+ * @brief Schedule writing @p data to the @p filename.
+ *
+ * This records the @p data to be written to the file. If there already is
+ * data pending for the same file, it is replaced. The data is written
+ * by a background thread after delay() milliseconds. If a @p cache is
+ * given, it is used to avoid reading back the file before writing it.
+ */
+void ItemWriter::schedule(const QString &filename, const QVariantMap &data,
+                          JsonUtils::JsonFileCachePtr cache)
+{
+    if (filename.isEmpty()) {
+        return;
+    }
+    QMutexLocker l(&m_lock);
+    m_pending.insert(filename, PendingWrite{data, cache});
+    if (!m_scheduled) {
+        m_scheduled = true;
+        QtConcurrent::run(&m_threadPool, [=]() {
+            {
+                QMutexLocker l(&m_lock);
+                if (!m_stopping) {
+                    m_wakeUp.wait(&m_lock, static_cast<unsigned long>(m_delay));
+                }
+            }
+            writeScheduled();
+        });
+    }
+}
+
+
+/**
+ * @brief Immediately write the @p data to the @p filename.
+ *
+ * Any pending data for the same file is discarded, as the @p data is
+ * considered to be more recent. Returns true on success or false otherwise.
+ */
+bool ItemWriter::write(const QString &filename, const QVariantMap &data,
+                       JsonUtils::JsonFileCachePtr cache)
+{
+    QMutexLocker wl(&m_writeLock);
+    {
+        QMutexLocker l(&m_lock);
+        m_pending.remove(filename);
+    }
+    return JsonUtils::patchJsonFile(filename, data, cache.data());
+}
+
+
+/**
+ * @brief Discard any pending data for the @p filename.
+ *
+ * This is used when an item is deleted. When this method returns, no
+ * write to the file is in progress or pending.
+ */
+void ItemWriter::cancel(const QString &filename)
+{
+    QMutexLocker wl(&m_writeLock);
+    QMutexLocker l(&m_lock);
+    m_pending.remove(filename);
+}
+
+
+/**
+ * @brief Write all pending data to disk.
+ *
+ * This writes pending changes in the calling thread and returns once
+ * all changes have been written. Returns true if all files could be
+ * written successfully.
+ */
+bool ItemWriter::flush()
+{
+    m_wakeUp.wakeAll();
+    QMutexLocker wl(&m_writeLock);
+    Batch batch;
+    {
+        QMutexLocker l(&m_lock);
+        batch.swap(m_pending);
+    }
+    return writeBatch(batch);
+}
+
+
+/**
+ * @brief Write pending data for the @p filename to disk.
+ *
+ * Returns true if either no data for the file was pending or if writing
+ * the pending data succeeded.
+ */
+bool ItemWriter::flush(const QString &filename)
+{
+    QMutexLocker wl(&m_writeLock);
+    Batch batch;
+    {
+        QMutexLocker l(&m_lock);
+        if (m_pending.contains(filename)) {
+            batch.insert(filename, m_pending.take(filename));
+        }
+    }
+    return writeBatch(batch);
+}
+
+
+/**
+ * @brief Returns true if there are changes which have not been written yet.
+ */
+bool ItemWriter::hasPendingWrites() const
+{
+    QMutexLocker l(&m_lock);
+    return !m_pending.isEmpty();
+}
+
+
+/**
+ * @brief The time in milliseconds changes are collected before being written.
+ */
+int ItemWriter::delay() const
+{
+    QMutexLocker l(&m_lock);
+    return m_delay;
+}
+
+
+/**
+ * @brief Set the write @p delay in milliseconds.
+ */
+void ItemWriter::setDelay(int delay)
+{
+    QMutexLocker l(&m_lock);
+    m_delay = qMax(0, delay);
+}
+
+
+void ItemWriter::writeScheduled()
+{
+    // Note: The batch is taken while holding the write lock. This
+    // ensures that writes to the same file happen in the order in which
+    // the data has been scheduled.
+    QMutexLocker wl(&m_writeLock);
+    Batch batch;
+    {
+        QMutexLocker l(&m_lock);
+        batch.swap(m_pending);
+        m_scheduled = false;
+    }
+    writeBatch(batch);
+}
+
+
+bool ItemWriter::writeBatch(const Batch &batch)
+{
+    bool result = true;
+    QStringList written;
+    for (auto it = batch.constBegin(); it != batch.constEnd(); ++it) {
+        if (JsonUtils::patchJsonFile(it.key(), it.value().data,
+                                     it.value().cache.data())) {
+            written << it.key();
+        } else {
+            qCWarning(itemWriter) << "Failed to write" << it.key();
+            result = false;
+        }
+    }
+    if (JsonUtils::syncPolicy() == JsonUtils::SyncPerBatch &&
+            !written.isEmpty()) {
+        if (!JsonUtils::syncDirectories(written)) {
+            qCWarning(itemWriter) << "Failed to sync written items to disk";
+        }
+    }
+    if (!batch.isEmpty()) {
+        qCDebug(itemWriter) << "Wrote" << batch.size() << "items";
+    }
+    return result;
+}
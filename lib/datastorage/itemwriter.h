@@ -0,0 +1,80 @@
+#ifndef ITEMWRITER_H
+#define ITEMWRITER_H
+
+#include <QHash>
+#include <QLoggingCategory>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <QVariantMap>
+#include <QWaitCondition>
+
+#include "utils/jsonutils.h"
+
+
+/**
+ * @brief Write-behind persistence of item data.
+ *
+ * The ItemWriter collects changes to items and writes them to disk in
+ * batches. Instead of rewriting an item's file each time one of its
+ * properties changes, items schedule() a snapshot of their properties.
+ * Snapshots for the same file are merged (i.e. only the latest one is kept)
+ * until the next batch is written by a background thread.
+ *
+ * Use flush() to make sure all pending changes are on disk, e.g. before
+ * the application exits or before a sync job starts to look at the files
+ * of a library.
+ *
+ * @note All methods of the class are thread safe.
+ */
+class ItemWriter
+{
+public:
+
+    static const int DefaultDelay;
+
+    ItemWriter();
+    virtual ~ItemWriter();
+
+    static ItemWriter *instance();
+
+    void schedule(const QString &filename, const QVariantMap &data,
+                  JsonUtils::JsonFileCachePtr cache = JsonUtils::JsonFileCachePtr());
+    bool write(const QString &filename, const QVariantMap &data,
+               JsonUtils::JsonFileCachePtr cache = JsonUtils::JsonFileCachePtr());
+    void cancel(const QString &filename);
+    bool flush();
+    bool flush(const QString &filename);
+
+    bool hasPendingWrites() const;
+
+    int delay() const;
+    void setDelay(int delay);
+
+private:
+
+    struct PendingWrite {
+        QVariantMap                 data;
+        JsonUtils::JsonFileCachePtr cache;
+    };
+
+    typedef QHash<QString, PendingWrite> Batch;
+
+    Batch                       m_pending;
+    QThreadPool                 m_threadPool;
+    mutable QMutex              m_lock;
+    QMutex                      m_writeLock;
+    QWaitCondition              m_wakeUp;
+    bool                        m_scheduled;
+    bool                        m_stopping;
+    int                         m_delay;
+
+    void writeScheduled();
+    bool writeBatch(const Batch &batch);
+
+};
+
+
+Q_DECLARE_LOGGING_CATEGORY(itemWriter)
+
+#endif // ITEMWRITER_H
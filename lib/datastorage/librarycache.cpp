@@ -0,0 +1,260 @@
+#include "librarycache.h"
+
+#include <QBuffer>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+
+#include "utils/jsonutils.h"
+
+
+Q_LOGGING_CATEGORY(libraryCache, "net.rpdev.opentodolist.LibraryCache", QtWarningMsg)
+
+
+/**
+ * @brief The name of the cache file within a library directory.
+ *
+ * The file is hidden, so it is neither picked up by the library loader
+ * nor synchronized to a remote server.
+ */
+const QString LibraryCache::FileName = ".otl-cache";
+
+/**
+ * @brief Identifies the file as an OpenTodoList library cache.
+ */
+const quint32 LibraryCache::Magic = 0x4f544c43; // "OTLC"
+
+/**
+ * @brief The version of the cache file format.
+ *
+ * Increase this whenever the file format or the set of properties stored
+ * per item changes. Cache files with a different version are ignored.
+ */
+const quint32 LibraryCache::Version = 1;
+
+
+/**
+ * @brief Constructor.
+ *
+ * Creates a cache for the library stored in the @p directory. The cache
+ * initially is empty; use load() to read a previously saved cache.
+ */
+LibraryCache::LibraryCache(const QString &directory) :
+    m_directory(directory),
+    m_entries(),
+    m_modified(false)
+{
+}
+
+
+/**
+ * @brief The directory of the library the cache belongs to.
+ */
+QString LibraryCache::directory() const
+{
+    return m_directory;
+}
+
+
+/**
+ * @brief The full path to the cache file.
+ */
+QString LibraryCache::fileName() const
+{
+    return QDir(m_directory).absoluteFilePath(FileName);
+}
+
+
+/**
+ * @brief Read the cache file from disk.
+ *
+ * Returns true if the cache has been loaded or false if the file does not
+ * exist, is corrupt or has been written using an incompatible version. In
+ * the latter cases, the cache is empty afterwards.
+ */
+bool LibraryCache::load()
+{
+    clear();
+    QFile file(fileName());
+    if (!file.exists() || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // Map the file into memory if possible, which saves copying the
+    // (potentially large) file content into a buffer first:
+    QByteArray content;
+    auto size = file.size();
+    auto mapped = size > 0 ? file.map(0, size) : nullptr;
+    if (mapped != nullptr) {
+        content = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped),
+                                          static_cast<int>(size));
+    } else {
+        content = file.readAll();
+    }
+
+    bool result = false;
+    {
+        QDataStream stream(content);
+        quint32 magic = 0;
+        quint32 version = 0;
+        stream >> magic >> version;
+        if (magic != Magic || version != Version) {
+            qCDebug(libraryCache) << "Ignoring incompatible cache file"
+                                  << file.fileName();
+        } else {
+            stream.setVersion(QDataStream::Qt_5_6);
+            quint32 count = 0;
+            stream >> count;
+            for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+                QString path;
+                Entry entry;
+                stream >> path >> entry.size >> entry.lastModified >> entry.data;
+                entry.used = false;
+                m_entries.insert(path, entry);
+            }
+            result = stream.status() == QDataStream::Ok;
+            if (!result) {
+                qCWarning(libraryCache) << "Cache file" << file.fileName()
+                                        << "is corrupt";
+            }
+        }
+    }
+
+    if (mapped != nullptr) {
+        file.unmap(mapped);
+    }
+    if (!result) {
+        clear();
+    }
+    return result;
+}
+
+
+/**
+ * @brief Write the cache to disk.
+ *
+ * The cache file is replaced atomically, so a crash while saving leaves
+ * the previous version of the cache in place. Returns true on success.
+ */
+bool LibraryCache::save()
+{
+    QByteArray content;
+    {
+        QBuffer buffer(&content);
+        buffer.open(QIODevice::WriteOnly);
+        QDataStream stream(&buffer);
+        stream << Magic << Version;
+        stream.setVersion(QDataStream::Qt_5_6);
+        stream << static_cast<quint32>(m_entries.size());
+        for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+            stream << it.key() << it.value().size << it.value().lastModified
+                   << it.value().data;
+        }
+    }
+    if (JsonUtils::writeFileAtomically(fileName(), content)) {
+        m_modified = false;
+        return true;
+    }
+    qCWarning(libraryCache) << "Failed to write cache file" << fileName();
+    return false;
+}
+
+
+/**
+ * @brief Look up the properties of an item file.
+ *
+ * The @p path is the path of the file relative to the library directory.
+ * If the cache holds an entry for it whose size and modification time
+ * match the ones in the @p fileInfo, the cached properties are stored in
+ * @p data and true is returned. Otherwise, false is returned.
+ */
+bool LibraryCache::lookup(const QString &path, const QFileInfo &fileInfo,
+                          QVariantMap *data)
+{
+    auto it = m_entries.find(path);
+    if (it != m_entries.end() &&
+            it->size == fileInfo.size() &&
+            it->lastModified == fileInfo.lastModified().toMSecsSinceEpoch()) {
+        it->used = true;
+        if (data != nullptr) {
+            *data = it->data;
+        }
+        return true;
+    }
+    return false;
+}
+
+
+/**
+ * @brief Store the @p data read from the file at @p path in the cache.
+ */
+void LibraryCache::insert(const QString &path, const QFileInfo &fileInfo,
+                          const QVariantMap &data)
+{
+    Entry entry;
+    entry.size = fileInfo.size();
+    entry.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+    entry.data = data;
+    entry.used = true;
+    m_entries.insert(path, entry);
+    m_modified = true;
+}
+
+
+/**
+ * @brief Remove the entry for the file at @p path.
+ */
+void LibraryCache::remove(const QString &path)
+{
+    if (m_entries.remove(path) > 0) {
+        m_modified = true;
+    }
+}
+
+
+/**
+ * @brief Remove all entries which have not been looked up or inserted.
+ *
+ * After a library has been scanned, this drops entries for files which
+ * have been removed in the meantime.
+ */
+void LibraryCache::removeUnused()
+{
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->used) {
+            it->used = false;
+            ++it;
+        } else {
+            it = m_entries.erase(it);
+            m_modified = true;
+        }
+    }
+}
+
+
+/**
+ * @brief Remove all entries from the cache.
+ */
+void LibraryCache::clear()
+{
+    m_entries.clear();
+    m_modified = false;
+}
+
+
+/**
+ * @brief The number of files in the cache.
+ */
+int LibraryCache::count() const
+{
+    return m_entries.size();
+}
+
+
+/**
+ * @brief Returns true if the cache changed since it has been loaded or saved.
+ */
+bool LibraryCache::isModified() const
+{
+    return m_modified;
+}
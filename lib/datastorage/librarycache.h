@@ -0,0 +1,80 @@
+#ifndef LIBRARYCACHE_H
+#define LIBRARYCACHE_H
+
+#include <QFileInfo>
+#include <QHash>
+#include <QLoggingCategory>
+#include <QString>
+#include <QVariantMap>
+
+
+/**
+ * @brief A binary cache of the items in a library.
+ *
+ * The LibraryCache is used to speed up loading of libraries. It holds the
+ * decoded properties of each item file in a library together with the size
+ * and modification time of the file at the time it has been read. When a
+ * library is loaded, only files whose size or modification time changed
+ * need to be parsed again; all other items can be restored from the cache.
+ *
+ * The cache is stored in a hidden file inside the library directory. The
+ * file is versioned; if it was written by an incompatible version of the
+ * application, it is ignored.
+ *
+ * @code
+ * LibraryCache cache(directory);
+ * cache.load();
+ * QVariantMap data;
+ * if (!cache.lookup(relativePath, fileInfo, &data)) {
+ *     data = JsonUtils::loadMap(fileInfo.absoluteFilePath());
+ *     cache.insert(relativePath, fileInfo, data);
+ * }
+ * cache.save();
+ * @endcode
+ */
+class LibraryCache
+{
+public:
+
+    static const QString FileName;
+    static const quint32 Magic;
+    static const quint32 Version;
+
+    explicit LibraryCache(const QString &directory = QString());
+
+    QString directory() const;
+    QString fileName() const;
+
+    bool load();
+    bool save();
+
+    bool lookup(const QString &path, const QFileInfo &fileInfo,
+                QVariantMap *data);
+    void insert(const QString &path, const QFileInfo &fileInfo,
+                const QVariantMap &data);
+    void remove(const QString &path);
+    void removeUnused();
+    void clear();
+
+    int count() const;
+    bool isModified() const;
+
+private:
+
+    struct Entry {
+        qint64      size;
+        qint64      lastModified;
+        QVariantMap data;
+        bool        used;
+    };
+
+    QString                 m_directory;
+    QHash<QString, Entry>   m_entries;
+    bool                    m_modified;
+
+};
+
+
+Q_DECLARE_LOGGING_CATEGORY(libraryCache)
+
+#endif // LIBRARYCACHE_H
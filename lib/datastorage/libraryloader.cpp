@@ -1,9 +1,13 @@
 #include "libraryloader.h"
 
 #include <QDebug>
+#include <QList>
 #include <QVariantMap>
+#include <QtConcurrent>
 
 #include "library.h"
+#include "librarycache.h"
+#include "utils/jsonutils.h"
 
 /**
  * @brief Constructor.
@@ -13,9 +17,10 @@ LibraryLoader::LibraryLoader(QObject *parent) : QObject(parent),
     m_worker(new LibraryLoaderWorker())
 {
     qRegisterMetaType<ItemPtr>();
+    qRegisterMetaType<QList<ItemPtr>>();
     m_thread.start();
     m_worker->moveToThread(&m_thread);
-    connect(m_worker, &LibraryLoaderWorker::itemLoaded, this, &LibraryLoader::itemLoaded);
+    connect(m_worker, &LibraryLoaderWorker::itemsLoaded, this, &LibraryLoader::itemsLoaded);
     connect(m_worker, &LibraryLoaderWorker::scanFinished, this, &LibraryLoader::scanFinished);
 }
 
@@ -24,7 +29,7 @@ LibraryLoader::LibraryLoader(QObject *parent) : QObject(parent),
  */
 LibraryLoader::~LibraryLoader()
 {
-    m_worker->m_stop = true;
+    m_worker->m_stop.storeRelease(1);
     m_thread.quit();
     if (!m_thread.wait(5000)) {
         m_thread.terminate();
@@ -49,11 +54,29 @@ void LibraryLoader::setDirectory(const QString& directory)
     m_directory = directory;
 }
 
+/**
+ * @brief The maximum number of threads used to load items.
+ */
+int LibraryLoader::threadCount() const
+{
+    return m_worker->m_threadPool.maxThreadCount();
+}
+
+/**
+ * @brief Set the maximum number of threads used to load items.
+ *
+ * By default, one thread per CPU core is used.
+ */
+void LibraryLoader::setThreadCount(int threadCount)
+{
+    m_worker->m_threadPool.setMaxThreadCount(qMax(1, threadCount));
+}
+
 /**
  * @brief Scan the directory for items.
  *
  * This triggers a scan of the directory for any kind of known item.
- * For each item discovered, the @p itemLoaded() signal is emitted.
+ * Discovered items are reported via the itemsLoaded() signal.
  */
 void LibraryLoader::scan()
 {
@@ -62,31 +85,187 @@ void LibraryLoader::scan()
                               Q_ARG(QObject*, thread()));
 }
 
+/**
+ * @brief Load the given @p files.
+ *
+ * This is used to update a library after some of its files changed. The
+ * @p files are absolute paths to item files within the directory. Files
+ * which did not change since they have been loaded the last time are
+ * skipped, files which no longer exist are dropped from the library cache.
+ * The loaded items are reported via the itemsLoaded() signal, followed by
+ * the scanFinished() signal.
+ */
+void LibraryLoader::loadFiles(const QStringList& files)
+{
+    QMetaObject::invokeMethod(m_worker, "loadFiles", Qt::QueuedConnection,
+                              Q_ARG(const QString&, m_directory),
+                              Q_ARG(const QStringList&, files),
+                              Q_ARG(QObject*, thread()));
+}
+
+/**
+ * @brief The number of files loaded by a single task of the worker pool.
+ */
+const int LibraryLoaderWorker::ChunkSize = 64;
+
 /**
  * @brief Constructor.
  */
 LibraryLoaderWorker::LibraryLoaderWorker() : QObject(),
-    m_stop(false)
+    m_stop(0),
+    m_threadPool()
 {
+    m_threadPool.setMaxThreadCount(QThread::idealThreadCount());
 }
 
 /**
  * @brief Scan the @p directory for items, moving any created one to the @p targetThread.
+ *
+ * Item files are only parsed if they are not yet in the library's cache
+ * or if they changed since the cache has been written. Afterwards, the
+ * cache is updated to reflect the current contents of the library.
+ *
+ * The files are split into chunks, which are loaded in parallel by the
+ * worker's thread pool. The items of each chunk are emitted as one batch.
+ * Batches are emitted in the order in which the files have been found,
+ * independent of which chunk finishes first.
  */
 void LibraryLoaderWorker::scan(const QString& directory, QObject* targetThread)
 {
+    LibraryCache cache(directory);
+    cache.load();
+    QDir root(directory);
+    LoadResults files;
     auto years = Library::years(directory);
     for (auto year : years) {
         auto months = Library::months(directory, year);
         for (auto month : months) {
+            if (m_stop.loadAcquire()) {
+                return;
+            }
             QDir dir(directory + "/" + year + "/" + month);
+            JsonUtils::recoverTempFiles(dir.absolutePath());
             QString suffix = "*." + Item::FileNameSuffix;
-            for (auto entry : dir.entryList({suffix}, QDir::Files)) {
-                auto item = Item::createItemFromFile(dir.absoluteFilePath(entry));
-                item->moveToThread(static_cast<QThread*>(targetThread));
-                emit itemLoaded(ItemPtr(item));
+            for (auto fileInfo : dir.entryInfoList({suffix}, QDir::Files)) {
+                LoadResult file;
+                file.path = root.relativeFilePath(fileInfo.absoluteFilePath());
+                file.fileInfo = fileInfo;
+                file.cached = cache.lookup(file.path, fileInfo, &file.data);
+                files << file;
+            }
+        }
+    }
+
+    if (load(files, &cache, static_cast<QThread*>(targetThread))) {
+        cache.removeUnused();
+        if (cache.isModified()) {
+            cache.save();
+        }
+        emit scanFinished();
+    }
+}
+
+/**
+ * @brief Load the @p files in the @p directory, moving created items to the @p targetThread.
+ *
+ * Files whose size and modification time match the library cache are
+ * skipped, as they have been loaded before.
+ */
+void LibraryLoaderWorker::loadFiles(const QString& directory, const QStringList& files,
+                                    QObject* targetThread)
+{
+    LibraryCache cache(directory);
+    cache.load();
+    QDir root(directory);
+    LoadResults changedFiles;
+    for (auto file : files) {
+        QFileInfo fileInfo(file);
+        auto path = root.relativeFilePath(fileInfo.absoluteFilePath());
+        if (!fileInfo.exists()) {
+            cache.remove(path);
+        } else if (!cache.lookup(path, fileInfo, nullptr)) {
+            LoadResult result;
+            result.path = path;
+            result.fileInfo = fileInfo;
+            result.cached = false;
+            changedFiles << result;
+        }
+    }
+    if (load(changedFiles, &cache, static_cast<QThread*>(targetThread))) {
+        if (cache.isModified()) {
+            cache.save();
+        }
+        emit scanFinished();
+    }
+}
+
+/**
+ * @brief Load the @p files in parallel and emit the created items.
+ *
+ * Items which had to be loaded from their files are added to the @p cache.
+ * Returns false if loading has been stopped.
+ */
+bool LibraryLoaderWorker::load(const LoadResults& files, LibraryCache* cache,
+                               QThread* targetThread)
+{
+    QList<QFuture<LoadResults>> chunks;
+    for (int i = 0; i < files.size(); i += ChunkSize) {
+        auto chunk = files.mid(i, ChunkSize);
+        chunks << QtConcurrent::run(&m_threadPool, [=]() {
+            return loadChunk(chunk, targetThread);
+        });
+    }
+
+    for (auto chunk : chunks) {
+        if (m_stop.loadAcquire()) {
+            return false;
+        }
+        QList<ItemPtr> items;
+        for (auto result : chunk.result()) {
+            if (!result.item.isNull()) {
+                if (!result.cached) {
+                    cache->insert(result.path, result.fileInfo, result.data);
+                }
+                items << result.item;
             }
         }
+        if (!items.isEmpty()) {
+            emit itemsLoaded(items);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Create the items for the files in the @p chunk.
+ *
+ * This is run by the worker's thread pool. Items are created either from
+ * their cached data or by parsing their file and are moved to the
+ * @p targetThread.
+ */
+LibraryLoaderWorker::LoadResults LibraryLoaderWorker::loadChunk(
+        LoadResults chunk, QThread* targetThread)
+{
+    for (auto &result : chunk) {
+        if (m_stop.loadAcquire()) {
+            break;
+        }
+        Item *item = nullptr;
+        if (result.cached) {
+            QVariantMap variant;
+            variant["filename"] = result.fileInfo.absoluteFilePath();
+            variant["data"] = result.data;
+            item = Item::createItem(QVariant(variant));
+        } else {
+            item = Item::createItemFromFile(result.fileInfo.absoluteFilePath());
+            if (item != nullptr) {
+                result.data = item->toMap();
+            }
+        }
+        if (item != nullptr) {
+            item->moveToThread(targetThread);
+            result.item = ItemPtr(item);
+        }
     }
-    emit scanFinished();
+    return chunk;
 }
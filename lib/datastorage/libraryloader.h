@@ -1,11 +1,18 @@
 #ifndef LIBRARYLOADER_H
 #define LIBRARYLOADER_H
 
+#include <QAtomicInt>
+#include <QFileInfo>
 #include <QObject>
+#include <QStringList>
 #include <QThread>
+#include <QThreadPool>
+#include <QVariantMap>
+#include <QVector>
 
 #include "item.h"
 
+class LibraryCache;
 class LibraryLoaderWorker;
 
 class LibraryLoader : public QObject
@@ -18,15 +25,19 @@ public:
     QString directory() const;
     void setDirectory(const QString& directory);
 
+    int threadCount() const;
+    void setThreadCount(int threadCount);
+
 signals:
 
     /**
-     * @brief An item has been loaded.
+     * @brief Items have been loaded.
      *
-     * This signal is emitted to indicate that an @p item has been
-     * found when scanning a library directory.
+     * This signal is emitted to indicate that the @p items have been
+     * found when scanning a library directory. Items are reported in
+     * batches to keep the number of cross-thread signals low.
      */
-    void itemLoaded(ItemPtr item);
+    void itemsLoaded(QList<ItemPtr> items);
 
     /**
      * @brief Scanning has finished.
@@ -36,6 +47,7 @@ signals:
 public slots:
 
     void scan();
+    void loadFiles(const QStringList &files);
 
 private:
 
@@ -53,17 +65,35 @@ class LibraryLoaderWorker : public QObject
 
 private:
 
-    bool m_stop;
+    struct LoadResult {
+        ItemPtr     item;
+        QString     path;
+        QFileInfo   fileInfo;
+        QVariantMap data;
+        bool        cached;
+    };
+
+    typedef QVector<LoadResult> LoadResults;
+
+    static const int ChunkSize;
+
+    QAtomicInt  m_stop;
+    QThreadPool m_threadPool;
 
     LibraryLoaderWorker();
 
+    bool load(const LoadResults &files, LibraryCache *cache, QThread *targetThread);
+    LoadResults loadChunk(LoadResults chunk, QThread *targetThread);
+
 private slots:
 
     void scan(const QString &directory, QObject* targetThread);
+    void loadFiles(const QString &directory, const QStringList &files,
+                   QObject* targetThread);
 
 signals:
 
-    void itemLoaded(ItemPtr item);
+    void itemsLoaded(QList<ItemPtr> items);
     void scanFinished();
 };
 
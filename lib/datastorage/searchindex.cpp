@@ -0,0 +1,181 @@
+#include "searchindex.h"
+
+
+/**
+ * @brief Constructor.
+ */
+SearchIndex::SearchIndex() :
+    m_uids(),
+    m_entries(),
+    m_parents()
+{
+}
+
+/**
+ * @brief Index the @p text of the @p item with the given @p uid.
+ *
+ * If the item already is in the index, its previous text is replaced.
+ */
+void SearchIndex::insert(Item* item, const QUuid& uid, const QString& text)
+{
+    QUuid parentUid;
+    auto it = m_entries.find(item);
+    if (it != m_entries.end()) {
+        parentUid = it->parentUid;
+        remove(item);
+    }
+    Entry entry;
+    entry.uid = uid;
+    entry.words = tokenize(text);
+    entry.words.removeDuplicates();
+    for (auto word : entry.words) {
+        m_uids[word].insert(uid);
+    }
+    m_entries.insert(item, entry);
+    setParent(item, parentUid);
+}
+
+/**
+ * @brief Set the uid of the parent of the @p item.
+ *
+ * If a search matches the item, the uid of its parent (and recursively the
+ * parent's parent) is returned as well.
+ */
+void SearchIndex::setParent(Item* item, const QUuid& parentUid)
+{
+    auto it = m_entries.find(item);
+    if (it != m_entries.end()) {
+        it->parentUid = parentUid;
+        if (parentUid.isNull()) {
+            m_parents.remove(it->uid);
+        } else {
+            m_parents.insert(it->uid, parentUid);
+        }
+    }
+}
+
+/**
+ * @brief Remove the @p item from the index.
+ *
+ * Returns true if the item has been in the index.
+ */
+bool SearchIndex::remove(Item* item)
+{
+    auto it = m_entries.find(item);
+    if (it == m_entries.end()) {
+        return false;
+    }
+    for (auto word : it->words) {
+        auto uids = m_uids.find(word);
+        if (uids != m_uids.end()) {
+            uids->remove(it->uid);
+            if (uids->isEmpty()) {
+                m_uids.erase(uids);
+            }
+        }
+    }
+    m_parents.remove(it->uid);
+    m_entries.erase(it);
+    return true;
+}
+
+/**
+ * @brief Check if the @p item is in the index.
+ */
+bool SearchIndex::contains(Item* item) const
+{
+    return m_entries.contains(item);
+}
+
+/**
+ * @brief Remove all items from the index.
+ */
+void SearchIndex::clear()
+{
+    m_uids.clear();
+    m_entries.clear();
+    m_parents.clear();
+}
+
+/**
+ * @brief The number of items in the index.
+ */
+int SearchIndex::count() const
+{
+    return m_entries.count();
+}
+
+/**
+ * @brief Find the items matching the @p query.
+ *
+ * The query is split into words. An item matches if it contains at least
+ * one word starting with any of the words of the query. The uids of the
+ * matching items and of their parents are returned.
+ *
+ * If @p cancelled is given and set to a non-zero value while the lookup
+ * runs, the lookup is aborted and an empty set is returned.
+ */
+QSet<QUuid> SearchIndex::find(const QString& query,
+                              const QAtomicInt* cancelled) const
+{
+    QSet<QUuid> result;
+    for (auto prefix : tokenize(query)) {
+        for (auto it = m_uids.lowerBound(prefix);
+             it != m_uids.end() && it.key().startsWith(prefix); ++it) {
+            if (cancelled != nullptr && cancelled->load()) {
+                return QSet<QUuid>();
+            }
+            result.unite(it.value());
+        }
+    }
+    for (auto uid : result.toList()) {
+        auto parent = m_parents.value(uid);
+        while (!parent.isNull() && !result.contains(parent)) {
+            result.insert(parent);
+            parent = m_parents.value(parent);
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Normalize the @p text for searching.
+ *
+ * This case folds the text and removes diacritics.
+ */
+QString SearchIndex::normalize(const QString& text)
+{
+    QString result;
+    auto decomposed = text.normalized(QString::NormalizationForm_KD);
+    result.reserve(decomposed.length());
+    for (auto ch : decomposed) {
+        if (ch.category() != QChar::Mark_NonSpacing) {
+            result.append(ch.toCaseFolded());
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Split the @p text into normalized words.
+ *
+ * Words are sequences of letters and numbers; any other character is
+ * considered to be a separator.
+ */
+QStringList SearchIndex::tokenize(const QString& text)
+{
+    QStringList result;
+    QString word;
+    for (auto ch : normalize(text)) {
+        if (ch.isLetterOrNumber()) {
+            word.append(ch);
+        } else if (!word.isEmpty()) {
+            result << word;
+            word.clear();
+        }
+    }
+    if (!word.isEmpty()) {
+        result << word;
+    }
+    return result;
+}
@@ -0,0 +1,67 @@
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QUuid>
+
+class Item;
+
+
+/**
+ * @brief An inverted full-text index over items.
+ *
+ * The SearchIndex maps the words contained in the searchable text of items
+ * (like their title and notes) to the items containing them. Words are
+ * normalized (i.e. case folded and with diacritics removed), so searching
+ * is case and accent insensitive. Lookups match word prefixes, i.e. a query
+ * "bu" finds items containing "Butter" or "buy".
+ *
+ * The index is updated incrementally by calling insert() whenever the text
+ * of an item changes and remove() when the item is gone. Items are only used
+ * as keys, so remove() can safely be called for items which are being
+ * destroyed. Lookups return the uids of the matching items together with the
+ * uids of their parents (as set via setParent()).
+ *
+ * The index is implicitly shared. Copying it is cheap, and a copy can be
+ * searched in a background thread while the original is updated.
+ */
+class SearchIndex
+{
+public:
+
+    SearchIndex();
+
+    void insert(Item *item, const QUuid &uid, const QString &text);
+    void setParent(Item *item, const QUuid &parentUid);
+    bool remove(Item *item);
+    bool contains(Item *item) const;
+    void clear();
+
+    int count() const;
+
+    QSet<QUuid> find(const QString &query,
+                     const QAtomicInt *cancelled = nullptr) const;
+
+    static QString normalize(const QString &text);
+    static QStringList tokenize(const QString &text);
+
+private:
+
+    struct Entry {
+        QUuid       uid;
+        QUuid       parentUid;
+        QStringList words;
+    };
+
+    QMap<QString, QSet<QUuid>>  m_uids;
+    QHash<Item*, Entry>         m_entries;
+    QHash<QUuid, QUuid>         m_parents;
+
+};
+
+#endif // SEARCHINDEX_H
@@ -0,0 +1,94 @@
+#include "stringarena.h"
+
+
+/**
+ * @brief Constructor.
+ */
+StringArena::StringArena() :
+    m_data(),
+    m_unused(0)
+{
+}
+
+/**
+ * @brief Append the @p string to the arena.
+ *
+ * Returns a reference which can be used to get the string back via value().
+ */
+StringArena::Ref StringArena::insert(const QString& string)
+{
+    Ref result;
+    result.offset = static_cast<quint32>(m_data.length());
+    result.length = static_cast<quint32>(string.length());
+    m_data.append(string);
+    return result;
+}
+
+/**
+ * @brief Get the string referenced by @p ref.
+ */
+QString StringArena::value(const Ref& ref) const
+{
+    return m_data.mid(static_cast<int>(ref.offset), static_cast<int>(ref.length));
+}
+
+/**
+ * @brief Check if the string referenced by @p ref equals @p string.
+ *
+ * This avoids creating a temporary copy of the referenced string.
+ */
+bool StringArena::equals(const Ref& ref, const QString& string) const
+{
+    return m_data.midRef(static_cast<int>(ref.offset),
+                         static_cast<int>(ref.length)) == string;
+}
+
+/**
+ * @brief Mark the space of the string referenced by @p ref as unused.
+ */
+void StringArena::release(const Ref& ref)
+{
+    m_unused += static_cast<int>(ref.length);
+}
+
+/**
+ * @brief Remove all strings from the arena.
+ */
+void StringArena::clear()
+{
+    m_data.clear();
+    m_unused = 0;
+}
+
+/**
+ * @brief Release any memory not required to hold the current strings.
+ */
+void StringArena::squeeze()
+{
+    m_data.squeeze();
+}
+
+/**
+ * @brief The number of characters stored in the arena.
+ */
+int StringArena::size() const
+{
+    return m_data.length();
+}
+
+/**
+ * @brief The number of characters which belong to released strings.
+ */
+int StringArena::unused() const
+{
+    return m_unused;
+}
+
+/**
+ * @brief The number of bytes allocated by the arena.
+ */
+int StringArena::memoryUsage() const
+{
+    return static_cast<int>(sizeof(StringArena)) +
+            m_data.capacity() * static_cast<int>(sizeof(QChar));
+}
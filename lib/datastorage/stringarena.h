@@ -0,0 +1,57 @@
+#ifndef STRINGARENA_H
+#define STRINGARENA_H
+
+#include <QString>
+
+
+/**
+ * @brief A buffer holding many strings back to back.
+ *
+ * Storing many small strings as individual QString objects is expensive:
+ * each one is a separate heap allocation with its own header. The
+ * StringArena instead appends all strings to one contiguous buffer and
+ * hands out Ref values (offset and length) which are used to get the
+ * strings back.
+ *
+ * Strings cannot be removed from the arena individually. Instead, release()
+ * marks the space of a string as unused. Owners of an arena can check
+ * unused() and build a fresh arena containing only the strings still in
+ * use if too much space is wasted.
+ */
+class StringArena
+{
+public:
+
+    /**
+     * @brief A reference to a string in the arena.
+     */
+    struct Ref {
+        quint32 offset;
+        quint32 length;
+
+        Ref() : offset(0), length(0) {}
+    };
+
+    StringArena();
+
+    Ref insert(const QString &string);
+    QString value(const Ref &ref) const;
+    bool equals(const Ref &ref, const QString &string) const;
+    void release(const Ref &ref);
+    void clear();
+    void squeeze();
+
+    int size() const;
+    int unused() const;
+    int memoryUsage() const;
+
+private:
+
+    QString m_data;
+    int     m_unused;
+
+};
+
+Q_DECLARE_TYPEINFO(StringArena::Ref, Q_PRIMITIVE_TYPE);
+
+#endif // STRINGARENA_H
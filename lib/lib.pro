@@ -24,6 +24,11 @@ SOURCES += \
     fileutils.cpp \
     datastorage/itemcontainer.cpp \
     datastorage/libraryloader.cpp \
+    datastorage/itemwriter.cpp \
+    datastorage/librarycache.cpp \
+    datastorage/searchindex.cpp \
+    datastorage/itemrecordstore.cpp \
+    datastorage/stringarena.cpp \
     models/itemsmodel.cpp \
     models/itemssortfiltermodel.cpp \
     migrators/migrator_2_x_to_3_x.cpp \
@@ -53,6 +58,11 @@ HEADERS += \
     abstractitemmodel.h \
     datastorage/itemcontainer.h \
     datastorage/libraryloader.h \
+    datastorage/itemwriter.h \
+    datastorage/librarycache.h \
+    datastorage/searchindex.h \
+    datastorage/itemrecordstore.h \
+    datastorage/stringarena.h \
     models/itemsmodel.h \
     models/itemssortfiltermodel.h \
     migrators/migrator_2_x_to_3_x.h \
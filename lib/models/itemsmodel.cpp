@@ -2,9 +2,14 @@
 
 #include <QQmlEngine>
 
+#include "task.h"
+#include "todo.h"
+#include "toplevelitem.h"
+
 ItemsModel::ItemsModel(QObject *parent) :
     QAbstractListModel(parent),
-    m_container()
+    m_container(),
+    m_records()
 {
     auto handleRowsChanged = [=](const QModelIndex&, int, int) {
         emit countChanged();
@@ -12,6 +17,7 @@ ItemsModel::ItemsModel(QObject *parent) :
     connect(this, &QAbstractListModel::rowsAboutToBeInserted, handleRowsChanged);
     connect(this, &QAbstractListModel::rowsAboutToBeRemoved, handleRowsChanged);
     connect(this, &ItemsModel::containerChanged, this, &ItemsModel::countChanged);
+    connect(this, &ItemsModel::recordsChanged, this, &ItemsModel::countChanged);
 }
 
 /**
@@ -24,6 +30,8 @@ ItemContainer*ItemsModel::container() const
 
 /**
  * @brief Set the item container.
+ *
+ * If a record store is set, it is unset.
  */
 void ItemsModel::setContainer(ItemContainer* container)
 {
@@ -31,27 +39,94 @@ void ItemsModel::setContainer(ItemContainer* container)
         if (m_container != nullptr) {
             disconnect(m_container.data(), &ItemContainer::itemAdded,
                        this, &ItemsModel::itemAdded);
+            disconnect(m_container.data(), &ItemContainer::itemsAdded,
+                       this, &ItemsModel::itemsAdded);
             disconnect(m_container.data(), &ItemContainer::itemDeleted,
                        this, &ItemsModel::itemDeleted);
             disconnect(m_container.data(), &ItemContainer::itemChanged,
                        this, &ItemsModel::itemChanged);
+            disconnect(m_container.data(), &ItemContainer::itemWeightChanged,
+                       this, &ItemsModel::itemWeightChanged);
             disconnect(m_container.data(), &ItemContainer::cleared,
                        this, &ItemsModel::cleared);
         }
+        bool recordsReset = false;
         beginResetModel();
         m_container = container;
+        if (m_container != nullptr && m_records != nullptr) {
+            // The model either works on a container or on a record store:
+            disconnect(m_records.data(), nullptr, this, nullptr);
+            m_records = nullptr;
+            recordsReset = true;
+        }
         endResetModel();
         if (m_container != nullptr) {
             connect(m_container.data(), &ItemContainer::itemAdded,
                     this, &ItemsModel::itemAdded);
+            connect(m_container.data(), &ItemContainer::itemsAdded,
+                    this, &ItemsModel::itemsAdded);
             connect(m_container.data(), &ItemContainer::itemDeleted,
                     this, &ItemsModel::itemDeleted);
             connect(m_container.data(), &ItemContainer::itemChanged,
                     this, &ItemsModel::itemChanged);
+            connect(m_container.data(), &ItemContainer::itemWeightChanged,
+                    this, &ItemsModel::itemWeightChanged);
             connect(m_container.data(), &ItemContainer::cleared,
                     this, &ItemsModel::cleared);
         }
         emit containerChanged();
+        if (recordsReset) {
+            emit recordsChanged();
+        }
+    }
+}
+
+/**
+ * @brief The item record store the model works on.
+ *
+ * If this is set, the model shows the records of the store instead of the
+ * items of a container. The container and records properties are mutually
+ * exclusive: Setting one of them unsets the other one.
+ */
+ItemRecordStore* ItemsModel::records() const
+{
+    return m_records.data();
+}
+
+/**
+ * @brief Set the item record store.
+ */
+void ItemsModel::setRecords(ItemRecordStore* records)
+{
+    if (records != m_records) {
+        if (m_records != nullptr) {
+            disconnect(m_records.data(), nullptr, this, nullptr);
+        }
+        bool containerReset = false;
+        beginResetModel();
+        m_records = records;
+        if (m_records != nullptr && m_container != nullptr) {
+            disconnect(m_container.data(), nullptr, this, nullptr);
+            m_container = nullptr;
+            containerReset = true;
+        }
+        endResetModel();
+        if (m_records != nullptr) {
+            connect(m_records.data(), &ItemRecordStore::recordsAdded,
+                    this, &ItemsModel::itemsAdded);
+            connect(m_records.data(), &ItemRecordStore::recordRemoved,
+                    this, &ItemsModel::itemDeleted);
+            connect(m_records.data(), &ItemRecordStore::recordChanged,
+                    this, &ItemsModel::recordChanged);
+            connect(m_records.data(), &ItemRecordStore::itemReleased,
+                    this, &ItemsModel::itemReleased);
+            connect(m_records.data(), &ItemRecordStore::cleared,
+                    this, &ItemsModel::cleared);
+        }
+        emit recordsChanged();
+        if (containerReset) {
+            emit containerChanged();
+        }
     }
 }
 
@@ -65,7 +140,9 @@ int ItemsModel::count() const
 
 int ItemsModel::rowCount(const QModelIndex& parent) const
 {
-    if (m_container && !parent.isValid()) {
+    if (m_records && !parent.isValid()) {
+        return m_records->count();
+    } else if (m_container && !parent.isValid()) {
         return m_container->count();
     } else {
         return 0;
@@ -75,6 +152,9 @@ int ItemsModel::rowCount(const QModelIndex& parent) const
 QVariant ItemsModel::data(const QModelIndex& index, int role) const
 {
     int row = index.row();
+    if (m_records) {
+        return recordData(row, role);
+    }
     if (m_container && row < m_container->count()) {
         auto item = m_container->item(row);
         switch (role) {
@@ -84,6 +164,46 @@ QVariant ItemsModel::data(const QModelIndex& index, int role) const
             return QVariant::fromValue<QObject*>(item.data());
         case WeightRole:
             return item.data()->weight();
+        case DoneRole:
+        {
+            auto todo = qobject_cast<Todo*>(item.data());
+            if (todo != nullptr) {
+                return todo->done();
+            }
+            auto task = qobject_cast<Task*>(item.data());
+            if (task != nullptr) {
+                return task->done();
+            }
+            break;
+        }
+        case TagsRole:
+        {
+            auto topLevelItem = qobject_cast<TopLevelItem*>(item.data());
+            if (topLevelItem != nullptr) {
+                return topLevelItem->tags();
+            }
+            break;
+        }
+        case TodoListUidRole:
+        {
+            auto todo = qobject_cast<Todo*>(item.data());
+            if (todo != nullptr) {
+                return todo->todoListUid();
+            }
+            break;
+        }
+        case TodoUidRole:
+        {
+            auto task = qobject_cast<Task*>(item.data());
+            if (task != nullptr) {
+                return task->todoUid();
+            }
+            break;
+        }
+        case ItemTypeRole:
+            return item.data()->itemType();
+        case UidRole:
+            return item.data()->uid();
         default:
             break;
         }
@@ -91,6 +211,62 @@ QVariant ItemsModel::data(const QModelIndex& index, int role) const
     return QVariant();
 }
 
+/**
+ * @brief Get the data for the @p role of the @p row from the record store.
+ *
+ * Only the ItemRole (and Qt::DisplayRole) cause the item of the row to be
+ * created.
+ */
+QVariant ItemsModel::recordData(int row, int role) const
+{
+    if (row < 0 || row >= m_records->count()) {
+        return QVariant();
+    }
+    switch (role) {
+    case Qt::DisplayRole:
+    case ItemRole:
+    {
+        auto item = m_records->item(row);
+        QQmlEngine::setObjectOwnership(item.data(), QQmlEngine::CppOwnership);
+        return QVariant::fromValue<QObject*>(item.data());
+    }
+    default:
+        break;
+    }
+    auto kind = m_records->kind(row);
+    switch (role) {
+    case WeightRole:
+        return m_records->weight(row);
+    case DoneRole:
+        if (kind != ItemRecordStore::TopLevelRecord) {
+            return m_records->done(row);
+        }
+        break;
+    case TagsRole:
+        if (kind == ItemRecordStore::TopLevelRecord) {
+            return m_records->tags(row);
+        }
+        break;
+    case TodoListUidRole:
+        if (kind == ItemRecordStore::TodoRecord) {
+            return m_records->parentUid(row);
+        }
+        break;
+    case TodoUidRole:
+        if (kind == ItemRecordStore::TaskRecord) {
+            return m_records->parentUid(row);
+        }
+        break;
+    case ItemTypeRole:
+        return m_records->itemType(row);
+    case UidRole:
+        return m_records->uid(row);
+    default:
+        break;
+    }
+    return QVariant();
+}
+
 QHash<int, QByteArray> ItemsModel::roleNames() const
 {
     auto result = QAbstractListModel::roleNames();
@@ -105,16 +281,35 @@ void ItemsModel::itemAdded(int index)
     endInsertRows();
 }
 
+void ItemsModel::itemsAdded(int first, int last)
+{
+    beginInsertRows(QModelIndex(), first, last);
+    endInsertRows();
+}
+
 void ItemsModel::itemDeleted(int index)
 {
     beginRemoveRows(QModelIndex(), index, index);
     endRemoveRows();
 }
 
+/**
+ * @brief The properties of the item at the @p index changed.
+ *
+ * The weight is reported separately by itemWeightChanged(), so sorting
+ * models only need to re-sort when the weight actually changed.
+ */
 void ItemsModel::itemChanged(int index)
 {
     auto idx = this->index(index, 0);
-    emit dataChanged(idx, idx);
+    emit dataChanged(idx, idx, {Qt::DisplayRole, ItemRole, DoneRole, TagsRole,
+                                TodoListUidRole, TodoUidRole});
+}
+
+void ItemsModel::itemWeightChanged(int index)
+{
+    auto idx = this->index(index, 0);
+    emit dataChanged(idx, idx, {WeightRole});
 }
 
 void ItemsModel::cleared()
@@ -122,3 +317,16 @@ void ItemsModel::cleared()
     beginResetModel();
     endResetModel();
 }
+
+void ItemsModel::recordChanged(int index)
+{
+    auto idx = this->index(index, 0);
+    emit dataChanged(idx, idx, {WeightRole, DoneRole, TagsRole,
+                                TodoListUidRole, TodoUidRole});
+}
+
+void ItemsModel::itemReleased(int index)
+{
+    auto idx = this->index(index, 0);
+    emit dataChanged(idx, idx, {Qt::DisplayRole, ItemRole});
+}
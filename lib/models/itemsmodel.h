@@ -6,22 +6,41 @@
 #include <QPointer>
 
 #include "itemcontainer.h"
+#include "itemrecordstore.h"
 
 /**
  * @brief A model working on a item container.
  *
  * This class implements the QAbstractListModel interface for items
  * contained in a ItemContainer.
+ *
+ * Besides the item itself, the model provides roles for the properties
+ * which are commonly used for filtering. These are read via the typed
+ * getters of the items, so filtering does not need to look up properties
+ * by name. Roles which do not apply to an item (e.g. the DoneRole for a
+ * note) yield an empty value.
+ *
+ * Instead of a container, the model can work on an ItemRecordStore. In this
+ * mode, rows are served from the records of the store and Item objects are
+ * only created for rows whose item is requested (via the ItemRole or
+ * Qt::DisplayRole), e.g. by the delegates a view currently shows.
  */
 class ItemsModel : public QAbstractListModel
 {
     Q_OBJECT
     Q_PROPERTY(ItemContainer* container READ container WRITE setContainer NOTIFY containerChanged)
+    Q_PROPERTY(ItemRecordStore* records READ records WRITE setRecords NOTIFY recordsChanged)
     Q_PROPERTY(int count READ count NOTIFY countChanged)
 public:
     enum Roles {
         ItemRole = Qt::UserRole,
-        WeightRole
+        WeightRole,
+        DoneRole,
+        TagsRole,
+        TodoListUidRole,
+        TodoUidRole,
+        ItemTypeRole,
+        UidRole
     };
 
     Q_ENUM(Roles)
@@ -31,6 +50,9 @@ public:
     ItemContainer* container() const;
     void setContainer(ItemContainer *container);
 
+    ItemRecordStore* records() const;
+    void setRecords(ItemRecordStore *records);
+
     int count() const;
 
     // QAbstractItemModel interface
@@ -41,6 +63,7 @@ public:
 signals:
 
     void containerChanged();
+    void recordsChanged();
     void countChanged();
 
 public slots:
@@ -48,13 +71,20 @@ public slots:
 private:
 
     QPointer<ItemContainer> m_container;
+    QPointer<ItemRecordStore> m_records;
+
+    QVariant recordData(int row, int role) const;
 
 private slots:
 
     void itemAdded(int index);
+    void itemsAdded(int first, int last);
     void itemDeleted(int index);
     void itemChanged(int index);
+    void itemWeightChanged(int index);
     void cleared();
+    void recordChanged(int index);
+    void itemReleased(int index);
 };
 
 #endif // ITEMSMODEL_H
@@ -1,5 +1,7 @@
 #include "itemssortfiltermodel.h"
 
+#include <QtConcurrent>
+#include <QTimer>
 #include <QUuid>
 
 #include "itemsmodel.h"
@@ -10,35 +12,59 @@
 #include "todo.h"
 #include "todolist.h"
 
+/**
+ * @brief The time (in milliseconds) changes of the search index are collected before searching again.
+ */
+const int ItemsSortFilterModel::SearchDelay = 200;
+
 ItemsSortFilterModel::ItemsSortFilterModel(QObject *parent) :
     QSortFilterProxyModel(parent),
     m_searchString(),
     m_defaultSearchResult(true),
     m_tag(),
+    m_tags(),
+    m_matchAllTags(true),
     m_onlyDone(false),
     m_onlyUndone(false),
     m_todoList(),
-    m_todo()
+    m_todo(),
+    m_library(),
+    m_appliedSearchString(),
+    m_searchHits(),
+    m_tagHits(),
+    m_searchCancelled(),
+    m_searchWatcher(nullptr),
+    m_searchTimer(new QTimer(this))
 {
+    m_searchTimer->setInterval(SearchDelay);
+    m_searchTimer->setSingleShot(true);
+    connect(m_searchTimer, &QTimer::timeout,
+            this, &ItemsSortFilterModel::startSearch);
+    // Note: With dynamic sorting enabled, new rows are inserted at their
+    // sorted position and changed rows are only moved if the sort role
+    // is affected, so there is no need to re-sort the whole model.
     setSortRole(ItemsModel::WeightRole);
+    setFilterRole(ItemsModel::ItemRole);
+    setDynamicSortFilter(true);
+    sort(0);
     auto handleRowsChanged = [=](const QModelIndex&, int, int) {
         emit countChanged();
-        sort(0);
     };
     connect(this, &QSortFilterProxyModel::rowsInserted, handleRowsChanged);
     connect(this, &QSortFilterProxyModel::rowsRemoved, handleRowsChanged);
     connect(this, &QSortFilterProxyModel::modelReset,
-            [=]() {
-        emit countChanged();
-        sort(0);
-    });
-    connect(this, &ItemsSortFilterModel::dataChanged,
-            [=](const QModelIndex&, const QModelIndex, QVector<int>) {
-        sort(0);
-    });
-    connect(this, &ItemsSortFilterModel::sourceModelChanged, [=]() {
-        sort(0);
-    });
+            this, &ItemsSortFilterModel::countChanged);
+}
+
+
+/**
+ * @brief Destructor.
+ */
+ItemsSortFilterModel::~ItemsSortFilterModel()
+{
+    if (m_searchWatcher != nullptr) {
+        m_searchCancelled->store(1);
+    }
 }
 
 
@@ -52,34 +78,48 @@ int ItemsSortFilterModel::count() const
 
 bool ItemsSortFilterModel::filterAcceptsRow(int source_row, const QModelIndex& source_parent) const
 {
-    Q_UNUSED(source_parent);
-
-    auto item = sourceModel()->data(sourceModel()->index(source_row, 0),
-                                    ItemsModel::ItemRole).value<Item*>();
+    auto index = sourceModel()->index(source_row, 0, source_parent);
     bool result = true;
 
-    if (item != nullptr) {
-        if (!m_tag.isEmpty()) {
-            result = result && item->property("tags").toStringList().contains(m_tag);
+    if (!m_tag.isEmpty() || !m_tags.isEmpty()) {
+        if (m_library != nullptr) {
+            result = m_tagHits.contains(index.data(ItemsModel::UidRole).toUuid());
+        } else {
+            result = tagsMatch(index.data(ItemsModel::TagsRole).toStringList());
         }
+    }
 
-        if (m_onlyDone) {
-            result = result && item->property("done").toBool();
-        }
+    if (m_onlyDone) {
+        result = result && index.data(ItemsModel::DoneRole).toBool();
+    }
 
-        if (m_onlyUndone) {
-            result = result && !item->property("done").toBool();
-        }
+    if (m_onlyUndone) {
+        result = result && !index.data(ItemsModel::DoneRole).toBool();
+    }
 
-        if (!m_todoList.isNull()) {
-            result = result && (item->property("todoListUid").toUuid() == m_todoList);
-        }
+    if (!m_todoList.isNull()) {
+        result = result && (index.data(ItemsModel::TodoListUidRole).toUuid() == m_todoList);
+    }
 
-        if (!m_todo.isNull()) {
-            result = result && (item->property("todoUid").toUuid() == m_todo);
-        }
+    if (!m_todo.isNull()) {
+        result = result && (index.data(ItemsModel::TodoUidRole).toUuid() == m_todo);
+    }
 
-        result = result && itemMatchesFilter(item);
+    if (result) {
+        if (m_library != nullptr) {
+            // Note: Until the results of a running search arrive, the
+            // results of the previous one are used.
+            if (m_appliedSearchString.isEmpty()) {
+                result = m_defaultSearchResult;
+            } else {
+                result = m_searchHits.contains(index.data(ItemsModel::UidRole).toUuid());
+            }
+        } else if (m_searchString.isEmpty()) {
+            result = m_defaultSearchResult;
+        } else {
+            auto item = index.data(ItemsModel::ItemRole).value<Item*>();
+            result = item == nullptr || itemMatchesFilter(item);
+        }
     }
 
     return result;
@@ -199,6 +239,251 @@ void ItemsSortFilterModel::setTag(const QString &tag)
     if (m_tag != tag) {
         m_tag = tag;
         emit tagChanged();
+        m_tagHits = tagHits();
+        invalidateFilter();
+    }
+}
+
+
+/**
+ * @brief Filter by several tags.
+ *
+ * If this is set to a non-empty list, only items will be shown which have
+ * all (or - if matchAllTags is false - any) of the tags set on them. The
+ * tag property is treated as one more tag in this list.
+ */
+QStringList ItemsSortFilterModel::tags() const
+{
+    return m_tags;
+}
+
+
+/**
+ * @brief Set the tags filter.
+ */
+void ItemsSortFilterModel::setTags(const QStringList &tags)
+{
+    if (m_tags != tags) {
+        m_tags = tags;
+        emit tagsChanged();
+        m_tagHits = tagHits();
+        invalidateFilter();
+    }
+}
+
+
+/**
+ * @brief Whether items must have all tags to be shown.
+ *
+ * If true (the default), the tag filters are combined with a logical AND,
+ * otherwise with a logical OR.
+ */
+bool ItemsSortFilterModel::matchAllTags() const
+{
+    return m_matchAllTags;
+}
+
+
+/**
+ * @brief Set whether items must have all tags to be shown.
+ */
+void ItemsSortFilterModel::setMatchAllTags(bool matchAllTags)
+{
+    if (m_matchAllTags != matchAllTags) {
+        m_matchAllTags = matchAllTags;
+        emit matchAllTagsChanged();
+        m_tagHits = tagHits();
+        invalidateFilter();
+    }
+}
+
+
+/**
+ * @brief The tags to filter for.
+ */
+QStringList ItemsSortFilterModel::tagFilter() const
+{
+    auto result = m_tags;
+    if (!m_tag.isEmpty() && !result.contains(m_tag)) {
+        result << m_tag;
+    }
+    return result;
+}
+
+
+/**
+ * @brief Look up the uids of the items matching the tag filters.
+ *
+ * This uses the tag index of the library and hence is only available if a
+ * library is set.
+ */
+QSet<QUuid> ItemsSortFilterModel::tagHits() const
+{
+    QSet<QUuid> result;
+    auto tags = tagFilter();
+    if (m_library != nullptr && !tags.isEmpty()) {
+        result = m_library->itemsWithTags(tags, m_matchAllTags);
+    }
+    return result;
+}
+
+
+/**
+ * @brief Check if the item @p tags match the tag filters.
+ *
+ * This is used if no library is set.
+ */
+bool ItemsSortFilterModel::tagsMatch(const QStringList &tags) const
+{
+    for (auto tag : tagFilter()) {
+        if (tags.contains(tag) != m_matchAllTags) {
+            return !m_matchAllTags;
+        }
+    }
+    return m_matchAllTags;
+}
+
+
+/**
+ * @brief Update the tag filter results after tags of items changed.
+ *
+ * The filter is only invalidated if the set of matching items changed.
+ */
+void ItemsSortFilterModel::updateTagHits()
+{
+    auto hits = tagHits();
+    if (hits != m_tagHits) {
+        m_tagHits = hits;
+        invalidateFilter();
+    }
+}
+
+/**
+ * @brief The library the items in the model belong to.
+ *
+ * If this is set, searching uses the search index of the library instead of
+ * inspecting the items (and their todos and tasks) one by one. The lookup
+ * runs in a background thread, so changing the search string does not block.
+ */
+Library *ItemsSortFilterModel::library() const
+{
+    return m_library;
+}
+
+
+/**
+ * @brief Set the library the items in the model belong to.
+ */
+void ItemsSortFilterModel::setLibrary(Library *library)
+{
+    if (m_library != library) {
+        if (m_library != nullptr) {
+            disconnect(m_library.data(), &Library::searchIndexChanged,
+                       this, &ItemsSortFilterModel::scheduleSearch);
+            disconnect(m_library.data(), &Library::itemTagsChanged,
+                       this, &ItemsSortFilterModel::updateTagHits);
+        }
+        m_library = library;
+        if (m_library != nullptr) {
+            connect(m_library.data(), &Library::searchIndexChanged,
+                    this, &ItemsSortFilterModel::scheduleSearch);
+            connect(m_library.data(), &Library::itemTagsChanged,
+                    this, &ItemsSortFilterModel::updateTagHits);
+        }
+        emit libraryChanged();
+        m_tagHits = tagHits();
+        invalidateFilter();
+        startSearch();
+    }
+}
+
+
+/**
+ * @brief Indicates if a search is running in the background.
+ *
+ * While a search is running, the model still shows the results of the
+ * previous search.
+ */
+bool ItemsSortFilterModel::searching() const
+{
+    return m_searchWatcher != nullptr;
+}
+
+
+/**
+ * @brief Look up the search string in the search index of the library.
+ *
+ * The lookup runs in a background thread on a copy of the search index. Any
+ * search which still is running is cancelled and its results are discarded.
+ * If no library is set, the filter is invalidated immediately.
+ */
+void ItemsSortFilterModel::startSearch()
+{
+    m_searchTimer->stop();
+    bool wasSearching = searching();
+    if (m_searchWatcher != nullptr) {
+        m_searchCancelled->store(1);
+        m_searchWatcher = nullptr;
+    }
+    if (m_library == nullptr) {
+        applySearchHits(m_searchString, QSet<QUuid>());
+    } else if (m_searchString.isEmpty()) {
+        applySearchHits(QString(), QSet<QUuid>());
+    } else {
+        auto index = m_library->searchIndex();
+        auto searchString = m_searchString;
+        auto cancelled = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+        auto watcher = new QFutureWatcher<QSet<QUuid>>(this);
+        connect(watcher, &QFutureWatcher<QSet<QUuid>>::finished, [=]() {
+            if (m_searchWatcher == watcher) {
+                m_searchWatcher = nullptr;
+                applySearchHits(searchString, watcher->result());
+                emit searchingChanged();
+            }
+            watcher->deleteLater();
+        });
+        m_searchCancelled = cancelled;
+        m_searchWatcher = watcher;
+        watcher->setFuture(QtConcurrent::run([=]() {
+            return index.find(searchString, cancelled.data());
+        }));
+    }
+    if (wasSearching != searching()) {
+        emit searchingChanged();
+    }
+}
+
+
+/**
+ * @brief Search again after the search index of the library changed.
+ *
+ * Changes are collected for SearchDelay milliseconds (counted from the first
+ * one) before the search is restarted. Each search works on a copy of the
+ * index, and the next change of the index in the library then needs to copy
+ * the whole index. Restarting for every change (e.g. for each batch of items
+ * while a library is loaded) would hence be expensive. If no search string is
+ * set, there is nothing to update.
+ */
+void ItemsSortFilterModel::scheduleSearch()
+{
+    if (!m_searchString.isEmpty() && !m_searchTimer->isActive()) {
+        m_searchTimer->start();
+    }
+}
+
+
+/**
+ * @brief Show the search results @p hits for the @p searchString.
+ *
+ * The filter is only invalidated if the results actually changed.
+ */
+void ItemsSortFilterModel::applySearchHits(const QString &searchString,
+                                           const QSet<QUuid> &hits)
+{
+    if (m_library == nullptr || searchString != m_appliedSearchString ||
+            hits != m_searchHits) {
+        m_appliedSearchString = searchString;
+        m_searchHits = hits;
         invalidateFilter();
     }
 }
@@ -206,7 +491,11 @@ void ItemsSortFilterModel::setTag(const QString &tag)
 bool ItemsSortFilterModel::itemMatchesFilter(Item *item) const
 {
     bool result = m_defaultSearchResult;
-    if (!m_searchString.isEmpty()) {
+    if (m_library != nullptr) {
+        if (!m_appliedSearchString.isEmpty()) {
+            result = m_searchHits.contains(item->uid());
+        }
+    } else if (!m_searchString.isEmpty()) {
         result = false;
         auto words = m_searchString.split(QRegExp("\\s+"), QString::SkipEmptyParts);
         auto itemMatches = [=](Item *item) {
@@ -266,13 +555,7 @@ QList<Todo *> ItemsSortFilterModel::todosOf(Item *item) const
     if (todoList != nullptr) {
         auto library = todoList->library();
         if (library != nullptr) {
-            auto todos = library->todos();
-            for (int i = 0; i < todos->count(); ++i) {
-                auto todo = dynamic_cast<Todo*>(todos->get(i));
-                if (todo != nullptr && todo->todoListUid() == item->uid()) {
-                    result << todo;
-                }
-            }
+            result = library->todosOf(item->uid());
         }
     }
     return result;
@@ -285,13 +568,7 @@ QList<Task *> ItemsSortFilterModel::tasksOf(Item *item) const
     if (todo != nullptr) {
         auto library = todo->library();
         if (library != nullptr) {
-            auto tasks = library->tasks();
-            for (int i = 0; i < tasks->count(); ++i) {
-                auto task = dynamic_cast<Task*>(tasks->get(i));
-                if (task != nullptr && task->todoUid() == item->uid()) {
-                    result << task;
-                }
-            }
+            result = library->tasksOf(item->uid());
         }
     }
     return result;
@@ -342,6 +619,6 @@ void ItemsSortFilterModel::setSearchString(const QString &searchString)
     if (m_searchString != searchString) {
         m_searchString = searchString;
         emit searchStringChanged();
-        invalidateFilter();
+        startSearch();
     }
 }
@@ -1,12 +1,20 @@
 #ifndef ITEMSSORTFILTERMODEL_H
 #define ITEMSSORTFILTERMODEL_H
 
+#include <QAtomicInt>
+#include <QFutureWatcher>
 #include <QJSValue>
 #include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QSharedPointer>
 #include <QSortFilterProxyModel>
 #include <QUuid>
 
+class QTimer;
+
 class Item;
+class Library;
 class Task;
 class Todo;
 
@@ -19,6 +27,9 @@ class ItemsSortFilterModel : public QSortFilterProxyModel
     Q_PROPERTY(bool defaultSearchResult READ defaultSearchResult
                WRITE setDefaultSearchResult NOTIFY defaultSearchResultChanged)
     Q_PROPERTY(QString tag READ tag WRITE setTag NOTIFY tagChanged)
+    Q_PROPERTY(QStringList tags READ tags WRITE setTags NOTIFY tagsChanged)
+    Q_PROPERTY(bool matchAllTags READ matchAllTags WRITE setMatchAllTags
+               NOTIFY matchAllTagsChanged)
     Q_PROPERTY(bool onlyDone READ onlyDone WRITE setOnlyDone
                NOTIFY onlyDoneChanged)
     Q_PROPERTY(bool onlyUndone READ onlyUndone WRITE setOnlyUndone
@@ -26,8 +37,12 @@ class ItemsSortFilterModel : public QSortFilterProxyModel
     Q_PROPERTY(QUuid todoList READ todoList WRITE setTodoList
                NOTIFY todoListChanged)
     Q_PROPERTY(QUuid todo READ todo WRITE setTodo NOTIFY todoChanged)
+    Q_PROPERTY(Library* library READ library WRITE setLibrary
+               NOTIFY libraryChanged)
+    Q_PROPERTY(bool searching READ searching NOTIFY searchingChanged)
 public:
     explicit ItemsSortFilterModel(QObject *parent = 0);
+    virtual ~ItemsSortFilterModel();
 
     int count() const;
 
@@ -40,6 +55,12 @@ public:
     QString tag() const;
     void setTag(const QString &tag);
 
+    QStringList tags() const;
+    void setTags(const QStringList &tags);
+
+    bool matchAllTags() const;
+    void setMatchAllTags(bool matchAllTags);
+
     bool onlyDone() const;
     void setOnlyDone(bool onlyDone);
 
@@ -52,16 +73,25 @@ public:
     QUuid todo() const;
     void setTodo(const QUuid &todo);
 
+    Library *library() const;
+    void setLibrary(Library *library);
+
+    bool searching() const;
+
 signals:
 
     void countChanged();
     void searchStringChanged();
     void defaultSearchResultChanged();
     void tagChanged();
+    void tagsChanged();
+    void matchAllTagsChanged();
     void onlyDoneChanged();
     void onlyUndoneChanged();
     void todoListChanged();
     void todoChanged();
+    void libraryChanged();
+    void searchingChanged();
 
 public slots:
 
@@ -71,18 +101,40 @@ protected:
 
 private:
 
+    static const int SearchDelay;
+
     QString m_searchString;
     bool    m_defaultSearchResult;
     QString m_tag;
+    QStringList m_tags;
+    bool    m_matchAllTags;
     bool    m_onlyDone;
     bool    m_onlyUndone;
     QUuid   m_todoList;
     QUuid   m_todo;
 
+    QPointer<Library>               m_library;
+    QString                         m_appliedSearchString;
+    QSet<QUuid>                     m_searchHits;
+    QSet<QUuid>                     m_tagHits;
+    QSharedPointer<QAtomicInt>      m_searchCancelled;
+    QFutureWatcher<QSet<QUuid>>    *m_searchWatcher;
+    QTimer                         *m_searchTimer;
+
+    void applySearchHits(const QString &searchString, const QSet<QUuid> &hits);
+    QStringList tagFilter() const;
+    QSet<QUuid> tagHits() const;
+    bool tagsMatch(const QStringList &tags) const;
     bool itemMatchesFilter(Item *item) const;
     QList<Todo*> todosOf(Item* item) const;
     QList<Task*> tasksOf(Item* item) const;
 
+private slots:
+
+    void startSearch();
+    void scheduleSearch();
+    void updateTagHits();
+
 };
 
 #endif // ITEMSSORTFILTERMODEL_H
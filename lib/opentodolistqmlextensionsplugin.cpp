@@ -11,6 +11,7 @@
 #include "todolist.h"
 #include "toplevelitem.h"
 #include "itemcontainer.h"
+#include "itemrecordstore.h"
 #include "itemsmodel.h"
 #include "itemssortfiltermodel.h"
 
@@ -43,6 +44,7 @@ void OpenTodoListQmlExtensionsPlugin::registerTypes(const char *uri)
   qmlRegisterType<TodoList>(uri, 1, 0, "TodoList");
   qmlRegisterType<TopLevelItem>(uri, 1, 0, "TopLevelItem");
   qmlRegisterType<ItemContainer>(uri, 1, 0, "ItemContainer");
+  qmlRegisterType<ItemRecordStore>(uri, 1, 0, "ItemRecordStore");
   qmlRegisterType<ItemsModel>(uri, 1, 0, "ItemsModel");
   qmlRegisterType<ItemsSortFilterModel>(uri, 1, 0, "ItemsSortFilterModel");
 
@@ -2,6 +2,8 @@
 
 #include "synchronizer.h"
 
+#include "datastorage/itemwriter.h"
+
 /**
  * @brief Create a new sync job.
  *
@@ -32,6 +34,8 @@ SyncJob::SyncJob(Library *library,
 void SyncJob::execute()
 {
     if (!m_libraryDirectory.isEmpty()) {
+        // Write pending item changes, so they get pushed to the server:
+        ItemWriter::instance()->flush();
         QScopedPointer<Synchronizer> sync(
                     Synchronizer::fromDirectory(m_libraryDirectory));
         sync->loadLog();
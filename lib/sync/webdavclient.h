@@ -3,20 +3,25 @@
 
 #include <tuple>
 
+#include <QAtomicInt>
 #include <QDateTime>
+#include <QHash>
 #include <QLoggingCategory>
 #include <QNetworkAccessManager>
 #include <QObject>
 #include <QRegularExpression>
+#include <QScopedPointer>
 #include <QSqlDatabase>
+#include <QSqlQuery>
 #include <QUrl>
+#include <QXmlStreamReader>
 
 
 class QDir;
-class QDomDocument;
-class QDomElement;
 class QNetworkAccessManager;
 class QNetworkReply;
+class QSemaphore;
+class QTemporaryFile;
 
 class WebDAVSynchronizer;
 
@@ -33,7 +38,11 @@ class WebDAVClient : public QObject
     friend class WebDAVSynchronizerTest;
 #endif
 public:
+
+    static const int DefaultMaxConcurrentTransfers;
+
     explicit WebDAVClient(QObject *parent = nullptr);
+    virtual ~WebDAVClient();
 
     QUrl baseUrl() const;
     void setBaseUrl(const QUrl &baseUrl);
@@ -53,6 +62,9 @@ public:
     QString password() const;
     void setPassword(const QString &password);
 
+    int maxConcurrentTransfers() const;
+    void setMaxConcurrentTransfers(int maxConcurrentTransfers);
+
 signals:
 
     void stopRequested();
@@ -126,8 +138,102 @@ private:
         }
     };
 
+    enum TransferType {
+        DownloadTransfer,
+        UploadTransfer,
+        MkdirTransfer,
+        DeleteTransfer
+    };
+
+    struct Transfer {
+        TransferType type;
+        SyncEntry entry;
+        QNetworkReply *reply;
+        QTemporaryFile *file;
+        bool result;
+
+        Transfer(TransferType type = DownloadTransfer,
+                 const SyncEntry &entry = SyncEntry()) :
+            type(type),
+            entry(entry),
+            reply(nullptr),
+            file(nullptr),
+            result(false)
+        {
+        }
+    };
+
     typedef QList<Entry> EntryList;
     typedef QMap<QString, SyncEntry> SyncEntryMap;
+    typedef QHash<QString, EntryList> RemoteTree;
+
+    enum SyncDBChangeType {
+        InsertIntoSyncDB,
+        RemoveFileFromSyncDB,
+        RemoveDirFromSyncDB
+    };
+
+    struct SyncDBChange {
+        SyncDBChangeType type;
+        SyncEntry entry;
+
+        SyncDBChange(SyncDBChangeType type = InsertIntoSyncDB,
+                     const SyncEntry &entry = SyncEntry()) :
+            type(type),
+            entry(entry)
+        {
+        }
+    };
+
+    typedef QList<SyncDBChange> SyncDBChanges;
+
+    struct SyncDBQueries {
+        QSqlQuery insert;
+        QSqlQuery removeFile;
+        QSqlQuery removeDir;
+
+        explicit SyncDBQueries(const QSqlDatabase &db) :
+            insert(db),
+            removeFile(db),
+            removeDir(db)
+        {
+        }
+    };
+
+    /**
+     * @brief An incremental parser for PROPFIND responses.
+     *
+     * The parser consumes the response body in chunks (e.g. as they arrive
+     * from the network) and extracts the entries from it without building
+     * a DOM of the whole response.
+     */
+    class PropFindParser
+    {
+    public:
+        PropFindParser(const QUrl &baseUrl, const QString &directory);
+
+        void addData(const QByteArray &data);
+        EntryList takeEntries();
+        bool hasError() const;
+        QString errorString() const;
+
+    private:
+        QXmlStreamReader m_reader;
+        QString m_baseDir;
+        EntryList m_entries;
+        bool m_started;
+        QString m_text;
+        QString m_href;
+        EntryType m_type;
+        QString m_etag;
+        bool m_inPropStat;
+        bool m_statusOk;
+        EntryType m_propType;
+        QString m_propEtag;
+
+        void startElement();
+        void endElement();
+    };
 
     QNetworkAccessManager *m_networkAccessManager;
     QUrl m_baseUrl;
@@ -136,10 +242,17 @@ private:
     bool m_disableCertificateCheck;
     QString m_username;
     QString m_password;
-    bool m_stopRequested;
+    int m_maxConcurrentTransfers;
+    QSemaphore *m_transferSlots;
+    QAtomicInt m_stopRequested;
+    RemoteTree m_remoteTree;
+    QSqlDatabase m_syncDb;
+    QScopedPointer<SyncDBQueries> m_syncDbQueries;
 
 
     EntryList entryList(const QString& directory, bool* ok = nullptr);
+    bool fetchRemoteTree();
+    static RemoteTree remoteTreeFromEntries(const EntryList &entries);
     bool download(const QString& filename, QIODevice* targetDevice = nullptr);
     QByteArray getRemoteFileContents(const QString& filename);
     bool upload(const QString& filename, QString *etag = nullptr);
@@ -156,25 +269,35 @@ private:
     QString urlString() const;
 
     QNetworkReply *listDirectoryRequest(const QString& directory);
+    QNetworkReply *listTreeRequest(const QString& directory);
     QNetworkReply *etagRequest(const QString& filename);
     QNetworkReply *createDirectoryRequest(const QString& directory);
+    QNetworkReply *downloadRequest(const QString& filename, QTemporaryFile *file);
+    QNetworkReply *uploadRequest(const QString& filename);
+    QNetworkReply *deleteRequest(const QString& filename);
+    QTemporaryFile *openDownloadFile();
+    bool downloadFinished(QNetworkReply *reply, QTemporaryFile *file,
+                          const QString& filename,
+                          QIODevice* targetDevice = nullptr);
+    bool uploadFinished(QNetworkReply *reply, const QString& filename,
+                        QString *etag);
+    bool mkdirFinished(QNetworkReply *reply, QString *etag);
+    bool deleteFinished(QNetworkReply *reply);
     static EntryList parseEntryList(const QUrl &baseUrl, const QString& directory,
                                     const QByteArray& reply);
-    static EntryList parsePropFindResponse(const QUrl &baseUrl, const QDomDocument& response,
-                                           const QString& directory);
-    static Entry parseResponseEntry(const QDomElement& element,
-                                    const QString& baseDir);
-    void prepareReply(QNetworkReply* reply) const;
+    void prepareReply(QNetworkReply* reply, bool reportErrors = true) const;
     static void waitForReplyToFinish(QNetworkReply* reply);
 
     // Sync DB Handling
     QSqlDatabase openSyncDb();
     void closeSyncDb();
-    void insertSyncDBEntry(QSqlDatabase &db, const SyncEntry &entry);
+    SyncDBQueries prepareSyncDBQueries(QSqlDatabase &db);
+    void applySyncDBChanges(QSqlDatabase &db, const SyncDBChanges &changes);
+    void insertSyncDBEntry(QSqlQuery &query, const SyncEntry &entry);
     SyncEntryMap findSyncDBEntries(QSqlDatabase &db,
                                               const QString& parent);
-    void removeDirFromSyncDB(QSqlDatabase &db, const SyncEntry &entry);
-    void removeFileFromSyncDB(QSqlDatabase &db, const SyncEntry &entry);
+    void removeDirFromSyncDB(QSqlQuery &query, const SyncEntry &entry);
+    void removeFileFromSyncDB(QSqlQuery &query, const SyncEntry &entry);
 
     // File System Utils
     bool rmLocalDir(const QString& dir, int maxDepth = 0);
@@ -182,11 +305,19 @@ private:
     // syncDirectory() split down methods:
     void mergeLocalInfoWithSyncList(
             QDir &d, const QString &dir, SyncEntryMap &entries);
-    bool mergeRemoteInfoWithSyncList(SyncEntryMap &entries, const QString &dir);
-    bool pullEntry(SyncEntry& entry, QSqlDatabase& db);
-    bool removeLocalEntry(SyncEntry& entry, QSqlDatabase& db);
-    bool pushEntry(SyncEntry& entry, QSqlDatabase& db);
-    bool removeRemoteEntry(SyncEntry& entry, QSqlDatabase& db);
+    bool mergeRemoteInfoWithSyncList(SyncEntryMap &entries, const QString &dir,
+                                     bool useRemoteTree = true);
+    bool pullEntry(SyncEntry& entry, SyncDBChanges &changes,
+                   QList<Transfer> &transfers);
+    bool removeLocalEntry(SyncEntry& entry, SyncDBChanges &changes);
+    bool pushEntry(SyncEntry& entry, SyncDBChanges &changes,
+                   QList<Transfer> &transfers);
+    bool removeRemoteEntry(SyncEntry& entry, QList<Transfer> &transfers);
+    bool runTransfers(QList<Transfer> &transfers, SyncDBChanges &changes);
+    bool acquireTransferSlot(bool wait);
+    void releaseTransferSlot();
+    QNetworkReply *startTransfer(Transfer &transfer);
+    bool finishTransfer(Transfer &transfer);
     bool skipEntry(const SyncEntry &entry, SyncStepDirection direction,
                    const QRegularExpression &dirFilter);
 };
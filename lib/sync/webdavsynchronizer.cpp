@@ -12,12 +12,14 @@
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QSemaphore>
 #include <QSharedPointer>
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QSqlQuery>
 #include <QSqlRecord>
 #include <QTemporaryFile>
+#include <QThreadPool>
 #include <QTimer>
 
 
@@ -29,6 +31,18 @@ Q_LOGGING_CATEGORY(webDAVSynchronizer,
 
 const QString WebDAVSynchronizer::SyncLockFileName = ".webdav-sync-running";
 
+/**
+ * @brief The number of month directories which are synced in parallel.
+ */
+const int WebDAVSynchronizer::MaxConcurrentDirectories = 3;
+
+/**
+ * @brief The maximum number of requests running at the same time.
+ *
+ * This is shared between all directories synced in parallel.
+ */
+const int WebDAVSynchronizer::MaxConnections = 6;
+
 
 WebDAVSynchronizer::WebDAVSynchronizer(QObject* parent) :
     Synchronizer(parent),
@@ -37,7 +51,7 @@ WebDAVSynchronizer::WebDAVSynchronizer(QObject* parent) :
     m_username(),
     m_password(),
     m_createDirs(false),
-    m_stopRequested(false),
+    m_stopRequested(0),
     m_findExistingEntriesWatcher()
 {
     connect(&m_findExistingEntriesWatcher,
@@ -112,7 +126,7 @@ void WebDAVSynchronizer::synchronize()
         connect(dav, &WebDAVClient::syncError,
                 this, &WebDAVSynchronizer::syncError);
         setSynchronizing(true);
-        m_stopRequested = false;
+        m_stopRequested.storeRelease(0);
         bool fullSync = false;
         {
             QDir syncDir(directory());
@@ -168,6 +182,15 @@ void WebDAVSynchronizer::synchronize()
         }
 
         if (dirsOkay) {
+            // Try to get the etags of all remote entries in one go, which
+            // saves listing each directory separately:
+            if (dav->fetchRemoteTree()) {
+                debug() << tr("Retrieved the remote directory tree");
+            } else {
+                debug() << tr("Server does not support listing the whole "
+                              "directory tree - listing directories one "
+                              "by one");
+            }
             QSet<QString> changedYearDirs;
             if (!dav->syncDirectory("/",
                                QRegularExpression("\\d\\d\\d\\d"),
@@ -176,10 +199,13 @@ void WebDAVSynchronizer::synchronize()
                 warning() << tr("Failed to synchronize top level "
                                 "directory!");
             }
-            // Sync the year directory:
+            // Sync the year directories. This tells us which month
+            // directories changed on the server, so it has to be done before
+            // syncing the month directories:
+            QList<DirectorySync> monthDirs;
             QDir dir(directory());
             for (auto yearDir : dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
-                if (m_stopRequested) {
+                if (m_stopRequested.loadAcquire()) {
                     break;
                 }
                 QSet<QString> changedMonthDirs;
@@ -193,19 +219,19 @@ void WebDAVSynchronizer::synchronize()
                 QDir ydir(dir.absoluteFilePath(yearDir));
                 for (auto monthDir : ydir.entryList(
                          QDir::Dirs | QDir::NoDotAndDotDot)) {
-                    if (m_stopRequested) {
-                        break;
-                    }
-                    if (!dav->syncDirectory("/" + yearDir + "/" + monthDir,
-                                       QRegularExpression(),
-                                            fullSync || !changedMonthDirs.contains(monthDir))) {
-                        warning() << tr("Failed to synchronize '%1'").arg(
-                                         "/" + yearDir + "/" + monthDir);
-                    }
+                    DirectorySync monthSync;
+                    monthSync.path = "/" + yearDir + "/" + monthDir;
+                    monthSync.pushOnly = fullSync ||
+                            !changedMonthDirs.contains(monthDir);
+                    monthDirs << monthSync;
                 }
             }
+            // The month directories are independent of each other:
+            if (!m_stopRequested.loadAcquire()) {
+                syncDirectories(monthDirs, dav);
+            }
         }
-        if (!m_stopRequested) {
+        if (!m_stopRequested.loadAcquire()) {
             QDir syncDir(directory());
             syncDir.remove(SyncLockFileName);
         }
@@ -219,7 +245,7 @@ void WebDAVSynchronizer::synchronize()
 void WebDAVSynchronizer::stopSync()
 {
     qCWarning(webDAVSynchronizer) << "Stopping WebDAV sync";
-    m_stopRequested = true;
+    m_stopRequested.storeRelease(1);
     emit stopRequested();
 }
 
@@ -408,6 +434,96 @@ void WebDAVSynchronizer::setUrl(const QUrl &url)
 }
 
 
+/**
+ * @brief Synchronize the @p directories concurrently.
+ *
+ * The directories are synced by up to MaxConcurrentDirectories worker
+ * threads, each using its own WebDAVClient (and hence its own SyncDB
+ * connection). The directories are picked up in order. All workers share
+ * MaxConnections transfer slots, so a worker can use the connections not
+ * needed by the others (e.g. when only a single directory is left). The
+ * workers use the remote tree fetched by the @p client (if any). Once the
+ * sync is stopped, no further directories are started. The method returns
+ * once all directories have been synced; in the meantime, the log messages
+ * of the workers are processed.
+ *
+ * The @p syncDirectory function is used to sync a single directory with
+ * one of the worker clients. By default, WebDAVClient::syncDirectory()
+ * is called.
+ */
+void WebDAVSynchronizer::syncDirectories(const QList<DirectorySync> &directories,
+                                         WebDAVClient *client,
+                                         DirectorySyncFunction syncDirectory)
+{
+    if (directories.isEmpty()) {
+        return;
+    }
+    if (!syncDirectory) {
+        syncDirectory = [](WebDAVClient *dav, const DirectorySync &sync) {
+            return dav->syncDirectory(sync.path, QRegularExpression(),
+                                      sync.pushOnly);
+        };
+    }
+    int numWorkers = qMin(MaxConcurrentDirectories, directories.length());
+    QSemaphore transferSlots(MaxConnections);
+    QAtomicInt next(0);
+    auto remoteTree = client->m_remoteTree;
+    auto worker = [&]() {
+        // Note: Objects created here live in the worker thread. Signals
+        // connected to this object are queued to the sync thread.
+        QScopedPointer<WebDAVClient> dav(createDAVClient());
+        dav->setMaxConcurrentTransfers(MaxConnections);
+        dav->m_transferSlots = &transferSlots;
+        dav->m_remoteTree = remoteTree;
+        connect(this, &WebDAVSynchronizer::stopRequested,
+                dav.data(), &WebDAVClient::stopSync, Qt::DirectConnection);
+        if (m_stopRequested.loadAcquire()) {
+            // Stopped before the connection above was made:
+            dav->stopSync();
+        }
+        connect(dav.data(), &WebDAVClient::debug, this, [=](const QString& message) {
+            debug() << message;
+        });
+        connect(dav.data(), &WebDAVClient::warning, this, [=](const QString& message) {
+            warning() << message;
+        });
+        connect(dav.data(), &WebDAVClient::error, this, [=](const QString& message) {
+            error() << message;
+        });
+        connect(dav.data(), &WebDAVClient::syncError,
+                this, &WebDAVSynchronizer::syncError);
+        forever {
+            int index = next.fetchAndAddOrdered(1);
+            if (m_stopRequested.loadAcquire() || index >= directories.length()) {
+                break;
+            }
+            const auto &sync = directories.at(index);
+            if (!syncDirectory(dav.data(), sync)) {
+                emit dav->warning(tr("Failed to synchronize '%1'").arg(
+                                      sync.path));
+            }
+        }
+    };
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(numWorkers);
+    QEventLoop loop;
+    int running = numWorkers;
+    QList<QSharedPointer<QFutureWatcher<void>>> watchers;
+    for (int i = 0; i < numWorkers; ++i) {
+        QSharedPointer<QFutureWatcher<void>> watcher(new QFutureWatcher<void>);
+        connect(watcher.data(), &QFutureWatcher<void>::finished, [&]() {
+            if (--running == 0) {
+                loop.quit();
+            }
+        });
+        watcher->setFuture(QtConcurrent::run(&pool, worker));
+        watchers << watcher;
+    }
+    loop.exec();
+}
+
+
 /**
  * @brief Create a DAV client.
  *
@@ -1,6 +1,9 @@
 #ifndef WEBDAVSYNCHRONIZER_H
 #define WEBDAVSYNCHRONIZER_H
 
+#include <functional>
+
+#include <QAtomicInt>
 #include <QList>
 #include <QLoggingCategory>
 #include <QRegularExpression>
@@ -88,6 +91,16 @@ signals:
 private:
 
     static const QString SyncLockFileName;
+    static const int MaxConcurrentDirectories;
+    static const int MaxConnections;
+
+    struct DirectorySync {
+        QString path;
+        bool pushOnly;
+    };
+
+    typedef std::function<bool (WebDAVClient *client, const DirectorySync &sync)>
+    DirectorySyncFunction;
 
     QUrl    m_url;
     QString m_remoteDirectory;
@@ -95,9 +108,13 @@ private:
     QString m_username;
     QString m_password;
     bool m_createDirs;
-    bool m_stopRequested;
+    QAtomicInt m_stopRequested;
     WebDAVServerType m_serverType;
     QFutureWatcher<QVariantList> m_findExistingEntriesWatcher;
+
+    void syncDirectories(const QList<DirectorySync> &directories,
+                         WebDAVClient *client,
+                         DirectorySyncFunction syncDirectory = DirectorySyncFunction());
 };
 
 
@@ -2,7 +2,54 @@
 
 #include <QDebug>
 #include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QFileSystemWatcher>
+#include <QSocketNotifier>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+/**
+ * @brief Returns true if no changes are recorded in the set.
+ */
+bool FileChangeSet::isEmpty() const
+{
+    return added.isEmpty() && modified.isEmpty() && removed.isEmpty();
+}
+
+/**
+ * @brief Merge the @p other changes into this set.
+ *
+ * The @p other changes are considered to be more recent. For example, if a file
+ * has been added and is removed afterwards, it is only reported as removed.
+ */
+void FileChangeSet::merge(const FileChangeSet &other)
+{
+    for (auto path : other.added) {
+        removed.removeAll(path);
+        if (!added.contains(path)) {
+            added << path;
+        }
+    }
+    for (auto path : other.modified) {
+        if (!added.contains(path) && !modified.contains(path)) {
+            modified << path;
+        }
+    }
+    for (auto path : other.removed) {
+        added.removeAll(path);
+        modified.removeAll(path);
+        if (!removed.contains(path)) {
+            removed << path;
+        }
+    }
+}
+
 
 /**
  * @brief Constructor.
@@ -11,11 +58,14 @@ DirectoryWatcher::DirectoryWatcher(QObject *parent) : QObject(parent),
     m_thread(new QThread(this)),
     m_worker(new DirectoryWatcherWorker())
 {
+    qRegisterMetaType<FileChangeSet>();
     m_thread->setObjectName("DirectoryWatcher");
     m_thread->start();
     m_worker->moveToThread(m_thread);
     connect(m_worker, &DirectoryWatcherWorker::directoryChanged,
             this, &DirectoryWatcher::directoryChanged);
+    connect(m_worker, &DirectoryWatcherWorker::filesChanged,
+            this, &DirectoryWatcher::filesChanged);
 }
 
 /**
@@ -23,12 +73,13 @@ DirectoryWatcher::DirectoryWatcher(QObject *parent) : QObject(parent),
  */
 DirectoryWatcher::~DirectoryWatcher()
 {
+    // Let the worker clean up in its own thread:
+    m_worker->deleteLater();
     m_thread->quit();
     if (!m_thread->wait(5000)) {
         m_thread->terminate();
         m_thread->wait(5000);
     }
-    delete m_worker;
 }
 
 /**
@@ -40,34 +91,81 @@ void DirectoryWatcher::setDirectory(const QString& directory)
                               Q_ARG(const QString&, directory));
 }
 
+/**
+ * @brief The maximum time (in milliseconds) events are collected before changes are reported.
+ */
+const int DirectoryWatcherWorker::DebounceInterval = 100;
+
 DirectoryWatcherWorker::DirectoryWatcherWorker():
     QObject(),
-    m_watcher(new QFileSystemWatcher(this)),
-    m_directory()
+    m_watcher(nullptr),
+    m_notifier(nullptr),
+    m_debounceTimer(nullptr),
+    m_inotifyFd(-1),
+    m_inotifyWatches(),
+    m_directory(),
+    m_snapshot(),
+    m_subDirs(),
+    m_dirtyDirs(),
+    m_dirtyFiles(),
+    m_initialized(false)
 {
-    connect(m_watcher, &QFileSystemWatcher::directoryChanged, [=](const QString& dir) {
-        emit directoryChanged();
-        if (!m_directory.isEmpty()) {
-            this->watchDir(dir);
-        }
-    });
-    connect(m_watcher, &QFileSystemWatcher::fileChanged, [=](const QString&) {
-        emit directoryChanged();
-    });
 }
 
 DirectoryWatcherWorker::~DirectoryWatcherWorker()
 {
+#ifdef Q_OS_LINUX
+    if (m_inotifyFd >= 0) {
+        delete m_notifier;
+        ::close(m_inotifyFd);
+    }
+#endif
+}
+
+/**
+ * @brief Set up the watcher backend.
+ *
+ * This is done lazily, so that all objects are created in the worker's thread.
+ */
+void DirectoryWatcherWorker::initialize()
+{
+    if (m_initialized) {
+        return;
+    }
+    m_initialized = true;
+    m_debounceTimer = new QTimer(this);
+    m_debounceTimer->setInterval(DebounceInterval);
+    m_debounceTimer->setSingleShot(true);
+    connect(m_debounceTimer, &QTimer::timeout,
+            this, &DirectoryWatcherWorker::reportChanges);
+#ifdef Q_OS_LINUX
+    m_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotifyFd >= 0) {
+        m_notifier = new QSocketNotifier(m_inotifyFd, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated,
+                this, &DirectoryWatcherWorker::readInotifyEvents);
+        return;
+    }
+    qWarning() << "Failed to initialize inotify - falling back to QFileSystemWatcher";
+#endif
+    m_watcher = new QFileSystemWatcher(this);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged,
+            this, &DirectoryWatcherWorker::handleDirectoryChanged);
+    connect(m_watcher, &QFileSystemWatcher::fileChanged,
+            this, &DirectoryWatcherWorker::handleFileChanged);
 }
 
 void DirectoryWatcherWorker::setDirectory(const QString& directory)
 {
     if (m_directory != directory) {
+        initialize();
         m_directory = directory;
-        auto items = m_watcher->files() + m_watcher->directories();
-        if (!items.isEmpty()) {
-            m_watcher->removePaths(items);
-        }
+        m_snapshot.clear();
+        m_subDirs.clear();
+        m_dirtyDirs.clear();
+        m_dirtyFiles.clear();
+        m_debounceTimer->stop();
+        removeWatches();
         if (!m_directory.isEmpty()) {
             watchDir(directory);
         }
@@ -76,19 +174,311 @@ void DirectoryWatcherWorker::setDirectory(const QString& directory)
 
 /**
  * @brief Watch the directory recursively.
+ *
+ * This records the current state of the files in the directory tree. Later changes
+ * are reported relative to this state.
  */
 void DirectoryWatcherWorker::watchDir(const QString& directory)
 {
     if (directory != "") {
-        QDir dir(directory);
-        if (dir.exists()) {
-            m_watcher->addPath(directory);
-            for (auto entry : dir.entryList(QDir::Files)) {
-                m_watcher->addPath(dir.absoluteFilePath(entry));
+        FileChangeSet initialState;
+        updateDir(directory, &initialState);
+    }
+}
+
+/**
+ * @brief Start watching the @p directory.
+ *
+ * When using the QFileSystemWatcher fallback, the files in the directory are
+ * watched as well (see updateDir()). This is required to be notified about files
+ * being modified in place.
+ */
+void DirectoryWatcherWorker::addWatch(const QString& directory)
+{
+#ifdef Q_OS_LINUX
+    if (m_inotifyFd >= 0) {
+        auto wd = inotify_add_watch(
+                    m_inotifyFd, QFile::encodeName(directory).constData(),
+                    IN_CREATE | IN_MODIFY | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                    IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+        if (wd >= 0) {
+            m_inotifyWatches.insert(wd, directory);
+        } else {
+            qWarning() << "Failed to watch" << directory;
+        }
+        return;
+    }
+#endif
+    if (m_watcher != nullptr) {
+        m_watcher->addPath(directory);
+    }
+}
+
+/**
+ * @brief Stop watching any directory.
+ */
+void DirectoryWatcherWorker::removeWatches()
+{
+#ifdef Q_OS_LINUX
+    for (auto wd : m_inotifyWatches.keys()) {
+        inotify_rm_watch(m_inotifyFd, wd);
+    }
+    m_inotifyWatches.clear();
+#endif
+    if (m_watcher != nullptr) {
+        auto items = m_watcher->files() + m_watcher->directories();
+        if (!items.isEmpty()) {
+            m_watcher->removePaths(items);
+        }
+    }
+}
+
+void DirectoryWatcherWorker::handleDirectoryChanged(const QString& directory)
+{
+    if (!m_directory.isEmpty()) {
+        m_dirtyDirs.insert(directory);
+        scheduleReport();
+    }
+}
+
+void DirectoryWatcherWorker::handleFileChanged(const QString& path)
+{
+    if (!m_directory.isEmpty()) {
+        // Note: Files which are replaced (e.g. by an atomic rename) drop out of the
+        // watcher, so re-scan the parent directory, which also re-adds them.
+        m_dirtyDirs.insert(QFileInfo(path).absolutePath());
+        scheduleReport();
+    }
+}
+
+/**
+ * @brief Read pending events from the inotify file descriptor.
+ *
+ * Events only mark the affected files and directories as dirty. They are
+ * compared with the recorded state a short time after the first of them came in.
+ */
+void DirectoryWatcherWorker::readInotifyEvents()
+{
+#ifdef Q_OS_LINUX
+    alignas(struct inotify_event) char buffer[4096];
+    forever {
+        auto length = ::read(m_inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+        for (char *ptr = buffer; ptr < buffer + length;) {
+            auto event = reinterpret_cast<const struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events got lost - compare all directories with their recorded state:
+                for (auto directory : m_snapshot.keys()) {
+                    m_dirtyDirs.insert(directory);
+                }
+                continue;
+            }
+            if (event->mask & IN_IGNORED) {
+                m_inotifyWatches.remove(event->wd);
+                continue;
+            }
+            auto directory = m_inotifyWatches.value(event->wd);
+            if (directory.isEmpty()) {
+                continue;
+            }
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                m_dirtyDirs.insert(directory);
+                continue;
             }
-            for (auto entry : dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
-                watchDir(dir.absoluteFilePath(entry));
+            QString name = event->len > 0 ? QFile::decodeName(event->name) : QString();
+            if (name.isEmpty() || name.startsWith(".")) {
+                continue;
             }
+            if (event->mask & IN_ISDIR) {
+                // Re-scanning the parent picks up new and removed sub-directories:
+                m_dirtyDirs.insert(directory);
+            } else {
+                m_dirtyFiles.insert(directory + "/" + name);
+            }
+        }
+    }
+    if (!m_dirtyDirs.isEmpty() || !m_dirtyFiles.isEmpty()) {
+        scheduleReport();
+    }
+#endif
+}
+
+/**
+ * @brief Report the changes once the debounce interval elapsed.
+ *
+ * A running timer is not restarted. Otherwise, changes would never be reported
+ * while events keep coming in (e.g. during a large sync).
+ */
+void DirectoryWatcherWorker::scheduleReport()
+{
+    if (!m_debounceTimer->isActive()) {
+        m_debounceTimer->start();
+    }
+}
+
+/**
+ * @brief Compare dirty files and directories with their recorded state and report changes.
+ */
+void DirectoryWatcherWorker::reportChanges()
+{
+    auto dirs = m_dirtyDirs;
+    auto files = m_dirtyFiles;
+    m_dirtyDirs.clear();
+    m_dirtyFiles.clear();
+    if (m_directory.isEmpty()) {
+        return;
+    }
+    FileChangeSet changes;
+    for (auto directory : dirs) {
+        updateDir(directory, &changes);
+    }
+    for (auto file : files) {
+        updateFile(file, &changes);
+    }
+    if (!changes.isEmpty()) {
+        emit directoryChanged();
+        emit filesChanged(changes);
+    }
+}
+
+/**
+ * @brief Compare the files in the @p directory with the recorded state.
+ *
+ * Any differences are recorded in the @p changes. Sub-directories which are not
+ * watched yet are added recursively.
+ */
+void DirectoryWatcherWorker::updateDir(const QString& directory, FileChangeSet* changes)
+{
+    QDir dir(directory);
+    if (!dir.exists()) {
+        removeDir(directory, changes);
+        return;
+    }
+    auto key = dir.absolutePath();
+    if (!m_snapshot.contains(key)) {
+        addWatch(key);
+        m_subDirs[QFileInfo(key).absolutePath()].insert(key);
+    }
+    auto &known = m_snapshot[key];
+    DirectoryState current;
+    for (auto fileInfo : dir.entryInfoList(QDir::Files)) {
+        auto path = fileInfo.absoluteFilePath();
+        FileState state{fileInfo.size(), fileInfo.lastModified()};
+        current.insert(path, state);
+        auto it = known.constFind(path);
+        if (it == known.constEnd()) {
+            changes->added << path;
+        } else if (it.value() != state) {
+            changes->modified << path;
+        } else {
+            continue;
+        }
+        if (m_watcher != nullptr) {
+            // Watch new files and re-add ones replaced by a rename, as
+            // these drop out of the watcher:
+            m_watcher->addPath(path);
+        }
+    }
+    for (auto it = known.constBegin(); it != known.constEnd(); ++it) {
+        if (!current.contains(it.key())) {
+            changes->removed << it.key();
         }
     }
+    known = current;
+    for (auto entry : dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        auto path = dir.absoluteFilePath(entry);
+        if (!m_snapshot.contains(path)) {
+            updateDir(path, changes);
+        }
+    }
+    for (auto path : m_subDirs.value(key)) {
+        if (!QDir(path).exists()) {
+            removeDir(path, changes);
+        }
+    }
+}
+
+/**
+ * @brief Compare the file at @p path with its recorded state.
+ *
+ * Any difference is recorded in the @p changes.
+ */
+void DirectoryWatcherWorker::updateFile(const QString& path, FileChangeSet* changes)
+{
+    QFileInfo fileInfo(path);
+    auto directory = fileInfo.absolutePath();
+    if (!m_snapshot.contains(directory)) {
+        return;
+    }
+    auto &known = m_snapshot[directory];
+    auto it = known.find(path);
+    if (fileInfo.exists() && fileInfo.isFile()) {
+        FileState state{fileInfo.size(), fileInfo.lastModified()};
+        if (it == known.end()) {
+            changes->added << path;
+            known.insert(path, state);
+        } else if (it.value() != state) {
+            changes->modified << path;
+            it.value() = state;
+        }
+    } else if (it != known.end()) {
+        changes->removed << path;
+        known.erase(it);
+    }
+}
+
+/**
+ * @brief Forget the @p directory and its sub-directories.
+ *
+ * All files recorded for them are reported as removed in the @p changes.
+ */
+void DirectoryWatcherWorker::removeDir(const QString& directory, FileChangeSet* changes)
+{
+    auto key = QDir(directory).absolutePath();
+    auto prefix = key + "/";
+    forgetDir(key, changes);
+#ifdef Q_OS_LINUX
+    for (auto wd : m_inotifyWatches.keys()) {
+        auto path = m_inotifyWatches.value(wd);
+        if (path == key || path.startsWith(prefix)) {
+            inotify_rm_watch(m_inotifyFd, wd);
+            m_inotifyWatches.remove(wd);
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Remove the recorded state of the @p directory and its sub-directories.
+ *
+ * All files recorded for them are reported as removed in the @p changes.
+ */
+void DirectoryWatcherWorker::forgetDir(const QString& directory, FileChangeSet* changes)
+{
+    for (auto path : m_subDirs.take(directory)) {
+        forgetDir(path, changes);
+    }
+    if (m_snapshot.contains(directory)) {
+        changes->removed << m_snapshot.take(directory).keys();
+        auto parent = m_subDirs.find(QFileInfo(directory).absolutePath());
+        if (parent != m_subDirs.end()) {
+            parent->remove(directory);
+            if (parent->isEmpty()) {
+                m_subDirs.erase(parent);
+            }
+        }
+    }
+}
+
+bool DirectoryWatcherWorker::FileState::operator ==(const FileState& other) const
+{
+    return size == other.size && lastModified == other.lastModified;
+}
+
+bool DirectoryWatcherWorker::FileState::operator !=(const FileState& other) const
+{
+    return !(*this == other);
 }
@@ -1,23 +1,59 @@
 #ifndef DIRECTORYWATCHER_H
 #define DIRECTORYWATCHER_H
 
+#include <QDateTime>
+#include <QHash>
+#include <QMetaType>
 #include <QObject>
+#include <QSet>
+#include <QStringList>
 #include <QThread>
 
 class QFileSystemWatcher;
+class QSocketNotifier;
+class QTimer;
 class DirectoryWatcherWorker;
 
+
+/**
+ * @brief A set of changes to files in a directory tree.
+ *
+ * This holds the absolute paths of files which have been added, modified or
+ * removed.
+ */
+struct FileChangeSet {
+    QStringList added;
+    QStringList modified;
+    QStringList removed;
+
+    bool isEmpty() const;
+    void merge(const FileChangeSet &other);
+};
+
+Q_DECLARE_METATYPE(FileChangeSet)
+
+
 /**
  * @brief A helper class used to watch a directory for any changes.
  *
- * This is a helper class which is used to monitor a single directory (non-recursively) for
+ * This is a helper class which is used to monitor a directory (recursively) for
  * any changes, including:
  *
  * - adding files
  * - removing files
  * - any contained files changed
  *
- * For any recognized change, the directoryChanged() signal is emitted.
+ * For any recognized change, the directoryChanged() signal is emitted. In addition,
+ * the filesChanged() signal reports which files exactly have been added, modified or
+ * removed. Files are considered to be modified if their size or modification time
+ * changed. Hidden files are ignored.
+ *
+ * On Linux, the watcher uses inotify directly and only watches directories, which
+ * keeps the number of watches low even for large libraries. On other platforms (or
+ * if inotify is not available), a QFileSystemWatcher is used as fallback. In both
+ * cases, events are collected for a short time before changes are reported. The
+ * delay is counted from the first event, so even a continuous stream of events
+ * is reported regularly.
  */
 class DirectoryWatcher : public QObject
 {
@@ -33,6 +69,13 @@ signals:
      */
     void directoryChanged();
 
+    /**
+     * @brief Files in the directory have been added, modified or removed.
+     *
+     * The @p changes hold the absolute paths of the affected files.
+     */
+    void filesChanged(const FileChangeSet &changes);
+
 public slots:
 
     void setDirectory(const QString &directory);
@@ -49,20 +92,55 @@ class DirectoryWatcherWorker : public QObject
 
     friend class DirectoryWatcher;
 
-    QFileSystemWatcher *m_watcher;
-    QString             m_directory;
+    struct FileState {
+        qint64      size;
+        QDateTime   lastModified;
+
+        bool operator ==(const FileState &other) const;
+        bool operator !=(const FileState &other) const;
+    };
+
+    typedef QHash<QString, FileState> DirectoryState;
+
+    static const int DebounceInterval;
+
+    QFileSystemWatcher             *m_watcher;
+    QSocketNotifier                *m_notifier;
+    QTimer                         *m_debounceTimer;
+    int                             m_inotifyFd;
+    QHash<int, QString>             m_inotifyWatches;
+    QString                         m_directory;
+    QHash<QString, DirectoryState>  m_snapshot;
+    QHash<QString, QSet<QString>>   m_subDirs;
+    QSet<QString>                   m_dirtyDirs;
+    QSet<QString>                   m_dirtyFiles;
+    bool                            m_initialized;
 
     explicit DirectoryWatcherWorker();
     virtual ~DirectoryWatcherWorker();
 
+    void initialize();
+    void addWatch(const QString &directory);
+    void removeWatches();
+    void updateDir(const QString &directory, FileChangeSet *changes);
+    void updateFile(const QString &path, FileChangeSet *changes);
+    void removeDir(const QString &directory, FileChangeSet *changes);
+    void forgetDir(const QString &directory, FileChangeSet *changes);
+    void scheduleReport();
+
 signals:
 
     void directoryChanged();
+    void filesChanged(const FileChangeSet &changes);
 
 private slots:
 
     void setDirectory(const QString &directory);
     void watchDir(const QString &directory);
+    void handleDirectoryChanged(const QString &directory);
+    void handleFileChanged(const QString &path);
+    void readInotifyEvents();
+    void reportChanges();
 };
 
 #endif // DIRECTORYWATCHER_H
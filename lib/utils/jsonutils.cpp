@@ -1,14 +1,189 @@
 #include "jsonutils.h"
 
+#include <QAtomicInt>
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QJsonDocument>
 #include <QJsonParseError>
+#include <QSet>
+#include <QTemporaryFile>
+
+#include <cstdio>
+
+#if defined(Q_OS_WIN)
+#include <io.h>
+#include <qt_windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 
 namespace JsonUtils {
 
 Q_LOGGING_CATEGORY(jsonUtils, "net.rpdev.opentodolist.JsonUtils", QtWarningMsg)
 
+
+/**
+ * @brief The suffix of temporary files used when writing files.
+ */
+const QString TempFileSuffix = ".otl-tmp";
+
+
+static QAtomicInt currentSyncPolicy(NoSync);
+
+
+/**
+ * @brief The temporary files which currently are being written.
+ *
+ * recoverTempFiles() must not touch these, as they are not left over from
+ * an interrupted write.
+ */
+struct ActiveTempFiles {
+    QMutex          lock;
+    QSet<QString>   files;
+};
+
+Q_GLOBAL_STATIC(ActiveTempFiles, activeTempFiles)
+
+
+static bool syncFileToDisk(QFile &file)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#if defined(Q_OS_WIN)
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+
+static bool syncDirectoryToDisk(const QString &directory)
+{
+#if defined(Q_OS_WIN)
+    // Note: Directories cannot be synced explicitly on Windows; the
+    // rename is made durable by the file system.
+    Q_UNUSED(directory);
+    return true;
+#else
+    auto fd = ::open(QFile::encodeName(directory).constData(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    auto result = ::fsync(fd) == 0;
+    ::close(fd);
+    return result;
+#endif
+}
+
+
+static bool replaceFile(const QString &source, const QString &target)
+{
+#if defined(Q_OS_WIN) && !defined(Q_OS_WINRT)
+    return MoveFileExW(
+                reinterpret_cast<const wchar_t*>(
+                    QDir::toNativeSeparators(source).utf16()),
+                reinterpret_cast<const wchar_t*>(
+                    QDir::toNativeSeparators(target).utf16()),
+                MOVEFILE_REPLACE_EXISTING) != 0;
+#elif defined(Q_OS_WIN)
+    QFile::remove(target);
+    return QFile::rename(source, target);
+#else
+    // Note: rename() atomically replaces the target on POSIX systems.
+    return std::rename(QFile::encodeName(source).constData(),
+                       QFile::encodeName(target).constData()) == 0;
+#endif
+}
+
+
+/**
+ * @brief The permissions a file replacing @p filename shall get.
+ *
+ * Temporary files are created readable and writable by their owner only.
+ * Replacing a file with them would hence restrict access to it. Instead,
+ * the permissions of the existing file are kept. New files get the
+ * permissions files usually get (i.e. readable by everyone).
+ */
+static QFileDevice::Permissions targetPermissions(const QString &filename)
+{
+    if (QFile::exists(filename)) {
+        return QFile::permissions(filename);
+    }
+    return QFileDevice::ReadOwner | QFileDevice::WriteOwner |
+            QFileDevice::ReadUser | QFileDevice::WriteUser |
+            QFileDevice::ReadGroup | QFileDevice::ReadOther;
+}
+
+
+/**
+ * @brief Constructor.
+ */
+JsonFileCache::JsonFileCache() :
+    lock(),
+    filename(),
+    properties(),
+    content(),
+    size(-1),
+    lastModified()
+{
+}
+
+
+/**
+ * @brief Check if the cache still reflects the file on disk.
+ *
+ * Returns true if the cache holds the contents of the @p filename and
+ * the size and modification time of the file did not change since.
+ */
+bool JsonFileCache::matches(const QString &filename) const
+{
+    if (this->filename.isEmpty() || this->filename != filename) {
+        return false;
+    }
+    QFileInfo fi(filename);
+    return fi.exists() && fi.size() == size &&
+            fi.lastModified() == lastModified;
+}
+
+
+/**
+ * @brief Record the @p properties and raw @p content of the @p filename.
+ *
+ * The size and modification time are taken from the file on disk.
+ */
+void JsonFileCache::update(const QString &filename, const QVariantMap &properties,
+                           const QByteArray &content)
+{
+    QFileInfo fi(filename);
+    if (fi.exists()) {
+        this->filename = filename;
+        this->properties = properties;
+        this->content = content;
+        this->size = fi.size();
+        this->lastModified = fi.lastModified();
+    } else {
+        clear();
+    }
+}
+
+
+/**
+ * @brief Invalidate the cache.
+ */
+void JsonFileCache::clear()
+{
+    filename.clear();
+    properties.clear();
+    content.clear();
+    size = -1;
+    lastModified = QDateTime();
+}
+
+
 /**
  * @brief Write a JSON file, keeping existing properties in the file.
  *
@@ -19,15 +194,25 @@ Q_LOGGING_CATEGORY(jsonUtils, "net.rpdev.opentodolist.JsonUtils", QtWarningMsg)
  * The intention of this function is to keep a set of files backwards compatible (e.g. if
  * users switch between versions of the application).
  *
+ * If a @p cache is given and it still reflects the file on disk, the
+ * existing properties are taken from it instead of reading and parsing
+ * the file. On success, the cache is updated with the written data.
+ *
  * The function returns true on success or false otherwise.
  */
-bool patchJsonFile(const QString& filename, const QVariantMap& data)
+bool patchJsonFile(const QString& filename, const QVariantMap& data,
+                   JsonFileCache *cache)
 {
     bool result = false;
+    QMutexLocker l(cache != nullptr ? &cache->lock : nullptr);
     QFile file(filename);
     QVariantMap properties;
     QByteArray existingFileContent;
-    if (file.exists()) {
+    bool cached = cache != nullptr && cache->matches(filename);
+    if (cached) {
+        properties = cache->properties;
+        existingFileContent = cache->content;
+    } else if (file.exists()) {
         if (file.open(QIODevice::ReadOnly)) {
             QJsonParseError error;
             existingFileContent = file.readAll();
@@ -50,16 +235,20 @@ bool patchJsonFile(const QString& filename, const QVariantMap& data)
     auto doc = QJsonDocument::fromVariant(properties);
     auto newFileContent = doc.toJson(QJsonDocument::Indented);
     if (newFileContent != existingFileContent) {
-        if (file.open(QIODevice::WriteOnly)) {
-            result = newFileContent.length() == file.write(newFileContent);
-            file.close();
-        } else {
-            qCWarning(jsonUtils) << "Failed to open" << filename << "for writing:"
-                                 << file.errorString();
+        result = writeFileAtomically(filename, newFileContent);
+        if (cache != nullptr) {
+            if (result) {
+                cache->update(filename, properties, newFileContent);
+            } else {
+                cache->clear();
+            }
         }
     } else {
         qCDebug(jsonUtils) << "File" << filename << "was not changed - "
                            << "skipping rewrite";
+        if (cache != nullptr && !cached) {
+            cache->update(filename, properties, newFileContent);
+        }
         result = true;
     }
     return result;
@@ -68,18 +257,26 @@ bool patchJsonFile(const QString& filename, const QVariantMap& data)
 
 /**
  * @brief Load a variant map from a JSON file.
+ *
+ * If a @p cache is given, it is updated with the contents read from the
+ * file.
  */
-QVariantMap loadMap(const QString& filename, bool* ok)
+QVariantMap loadMap(const QString& filename, bool* ok, JsonFileCache *cache)
 {
     bool success = false;
     QVariantMap result;
+    QMutexLocker l(cache != nullptr ? &cache->lock : nullptr);
     QFile file(filename);
     if (file.open(QIODevice::ReadOnly)) {
         QJsonParseError error;
-        auto doc = QJsonDocument::fromJson(file.readAll(), &error);
+        auto content = file.readAll();
+        auto doc = QJsonDocument::fromJson(content, &error);
         if (error.error == QJsonParseError::NoError) {
             result = doc.toVariant().toMap();
             success = true;
+            if (cache != nullptr) {
+                cache->update(filename, result, content);
+            }
         } else {
             qCWarning(jsonUtils) << "Failed to parse" << filename << ":"
                                  << error.errorString();
@@ -89,11 +286,211 @@ QVariantMap loadMap(const QString& filename, bool* ok)
         qCWarning(jsonUtils) << "Failed to open" << filename << "for reading:"
                              << file.errorString();
     }
+    if (!success && cache != nullptr) {
+        cache->clear();
+    }
     if (ok != nullptr) {
         *ok = success;
     }
     return result;
 }
 
+
+
+/**
+ * @brief The policy used to sync written files to disk.
+ *
+ * By default, files are not synced explicitly.
+ */
+SyncPolicy syncPolicy()
+{
+    return static_cast<SyncPolicy>(currentSyncPolicy.load());
+}
+
+
+/**
+ * @brief Set the sync @p policy used when writing files.
+ */
+void setSyncPolicy(SyncPolicy policy)
+{
+    currentSyncPolicy.store(policy);
+}
+
+
+/**
+ * @brief Get the template for temporary files used when writing @p filename.
+ *
+ * The temporary file is a hidden file next to the target file, so it is
+ * ignored by the library loader and by synchronization. The XXXXXX part
+ * is replaced by a unique string, so several writers can write the same
+ * target at the same time without clobbering each other's temporary file.
+ */
+QString tempFileTemplate(const QString &filename)
+{
+    QFileInfo fi(filename);
+    return fi.dir().absoluteFilePath("." + fi.fileName() + ".XXXXXX" +
+                                     TempFileSuffix);
+}
+
+
+/**
+ * @brief Write the @p content to the @p filename atomically.
+ *
+ * The content is written to a temporary file first, which then replaces
+ * the target file. Hence, the target file either keeps its old content or
+ * has the new one, but it never is left truncated. Unless the syncPolicy()
+ * is NoSync, the temporary file is synced to disk before it replaces the
+ * target. With SyncPerFile, the directory is synced afterwards as well to
+ * make the replacement itself durable; with SyncPerBatch, this is left to
+ * the writer calling syncDirectories() after a batch. The permissions of
+ * an existing target file are kept.
+ */
+bool writeFileAtomically(const QString &filename, const QByteArray &content)
+{
+    bool result = false;
+    auto policy = syncPolicy();
+    QTemporaryFile file(tempFileTemplate(filename));
+    file.setAutoRemove(false);
+    bool opened;
+    {
+        QMutexLocker l(&activeTempFiles->lock);
+        opened = file.open();
+        if (opened) {
+            activeTempFiles->files.insert(file.fileName());
+        }
+    }
+    if (opened) {
+        auto tmpFileName = file.fileName();
+        result = content.length() == file.write(content);
+        if (result && !file.setPermissions(targetPermissions(filename))) {
+            qCWarning(jsonUtils) << "Failed to set permissions of"
+                                 << tmpFileName;
+        }
+        if (result && policy != NoSync) {
+            if (!syncFileToDisk(file)) {
+                qCWarning(jsonUtils) << "Failed to sync" << tmpFileName
+                                     << "to disk";
+            }
+        }
+        file.close();
+        if (result) {
+            result = replaceFile(tmpFileName, filename);
+            if (!result) {
+                qCWarning(jsonUtils) << "Failed to replace" << filename
+                                     << "with" << tmpFileName;
+            }
+        } else {
+            qCWarning(jsonUtils) << "Failed to write" << tmpFileName << ":"
+                                 << file.errorString();
+        }
+        if (!result) {
+            QFile::remove(tmpFileName);
+        } else if (policy == SyncPerFile) {
+            if (!syncDirectoryToDisk(QFileInfo(filename).absolutePath())) {
+                qCWarning(jsonUtils) << "Failed to sync the directory of"
+                                     << filename << "to disk";
+            }
+        }
+        QMutexLocker l(&activeTempFiles->lock);
+        activeTempFiles->files.remove(tmpFileName);
+    } else {
+        qCWarning(jsonUtils) << "Failed to open" << file.fileTemplate()
+                             << "for writing:" << file.errorString();
+    }
+    return result;
+}
+
+
+/**
+ * @brief Sync the directories containing the @p filenames to disk.
+ *
+ * This is used to implement the SyncPerBatch policy: Writers call this
+ * method once after they wrote a set of files. As the files themselves
+ * already have been synced before they replaced their targets, only the
+ * directory entries are left to be synced. Each directory is synced once,
+ * no matter how many of the files it contains.
+ */
+bool syncDirectories(const QStringList &filenames)
+{
+    bool result = true;
+    QSet<QString> directories;
+    for (auto filename : filenames) {
+        directories.insert(QFileInfo(filename).absolutePath());
+    }
+    for (auto directory : directories) {
+        if (!syncDirectoryToDisk(directory)) {
+            qCWarning(jsonUtils) << "Failed to sync" << directory << "to disk";
+            result = false;
+        }
+    }
+    return result;
 }
 
+
+/**
+ * @brief Recover from interrupted writes in the @p directory.
+ *
+ * This scans the directory for temporary files left behind by
+ * writeFileAtomically(), e.g. because the application crashed. If the
+ * target file of such a temporary file is missing or cannot be parsed but
+ * the temporary file holds valid JSON, the temporary file is used to
+ * restore the target. If there are several temporary files for the same
+ * target, the most recent valid one is used. Otherwise, the temporary
+ * file is removed.
+ *
+ * Temporary files which currently are being written by
+ * writeFileAtomically() in this process are left alone, so it is safe to
+ * call this function while writers are active.
+ *
+ * Returns the number of files which have been restored.
+ */
+int recoverTempFiles(const QString &directory)
+{
+    int result = 0;
+    QDir dir(directory);
+    auto filter = QStringList({".*" + TempFileSuffix});
+    for (auto entry : dir.entryList(filter, QDir::Files | QDir::Hidden,
+                                    QDir::Time)) {
+        auto tmpFileName = dir.absoluteFilePath(entry);
+        {
+            // Note: Temporary files are registered while they are
+            // created, so any file not registered here is either stale or
+            // has already been moved into place by its writer.
+            QMutexLocker l(&activeTempFiles->lock);
+            if (activeTempFiles->files.contains(tmpFileName)) {
+                continue;
+            }
+        }
+        // Strip the leading dot, the unique part and the suffix:
+        auto targetName = entry.mid(1, entry.length() - 1 -
+                                    TempFileSuffix.length());
+        targetName = targetName.left(targetName.lastIndexOf('.'));
+        if (targetName.isEmpty()) {
+            continue;
+        }
+        auto filename = dir.absoluteFilePath(targetName);
+        auto isValidJson = [](const QString &filename) {
+            QFile file(filename);
+            if (file.open(QIODevice::ReadOnly)) {
+                QJsonParseError error;
+                QJsonDocument::fromJson(file.readAll(), &error);
+                return error.error == QJsonParseError::NoError;
+            }
+            return false;
+        };
+        if (!isValidJson(filename) && isValidJson(tmpFileName)) {
+            qCWarning(jsonUtils) << "Restoring" << filename << "from"
+                                 << tmpFileName;
+            QFile::setPermissions(tmpFileName, targetPermissions(filename));
+            if (replaceFile(tmpFileName, filename)) {
+                ++result;
+                continue;
+            }
+        }
+        qCDebug(jsonUtils) << "Removing stale temporary file" << tmpFileName;
+        QFile::remove(tmpFileName);
+    }
+    return result;
+}
+
+}
@@ -2,7 +2,12 @@
 #define JSONUTILS_H
 
 
+#include <QByteArray>
+#include <QDateTime>
+#include <QMutex>
+#include <QSharedPointer>
 #include <QString>
+#include <QStringList>
 #include <QVariantMap>
 #include <QLoggingCategory>
 
@@ -14,8 +19,66 @@
  */
 namespace JsonUtils {
 
-bool patchJsonFile(const QString &filename, const QVariantMap &data);
-QVariantMap loadMap(const QString &filename, bool* ok = nullptr);
+/**
+ * @brief Controls when written files are flushed to the storage device.
+ *
+ * Files are always written to a temporary file first, which then replaces
+ * the target file. This ensures that a crash never leaves a truncated
+ * file behind. The sync policy determines if and when the data is
+ * explicitly synced to disk, which protects against data loss on power
+ * failures at the cost of write performance.
+ */
+enum SyncPolicy {
+    NoSync,         //!< Leave syncing to the operating system.
+    SyncPerBatch,   //!< Sync each file, but its directory only once per batch.
+    SyncPerFile     //!< Sync each file and its directory on every write.
+};
+
+extern const QString TempFileSuffix;
+
+/**
+ * @brief In-memory copy of a JSON file on disk.
+ *
+ * This structure holds the last known contents of a JSON file, both as
+ * raw bytes and as parsed properties (including properties unknown to the
+ * application). It can be passed to loadMap() and patchJsonFile() to avoid
+ * reading back a file before writing it. The cached data is only used if
+ * the size and modification time of the file on disk still match the
+ * recorded ones.
+ *
+ * The structure can be shared between threads; any access to its members
+ * must happen while holding the lock.
+ */
+struct JsonFileCache {
+    QMutex      lock;
+    QString     filename;
+    QVariantMap properties;
+    QByteArray  content;
+    qint64      size;
+    QDateTime   lastModified;
+
+    JsonFileCache();
+
+    bool matches(const QString &filename) const;
+    void update(const QString &filename, const QVariantMap &properties,
+                const QByteArray &content);
+    void clear();
+};
+
+typedef QSharedPointer<JsonFileCache> JsonFileCachePtr;
+
+bool patchJsonFile(const QString &filename, const QVariantMap &data,
+                   JsonFileCache *cache = nullptr);
+QVariantMap loadMap(const QString &filename, bool* ok = nullptr,
+                    JsonFileCache *cache = nullptr);
+
+SyncPolicy syncPolicy();
+void setSyncPolicy(SyncPolicy policy);
+
+QString tempFileTemplate(const QString &filename);
+bool writeFileAtomically(const QString &filename, const QByteArray &content);
+bool syncDirectories(const QStringList &filenames);
+int recoverTempFiles(const QString &directory);
 
 
 Q_DECLARE_LOGGING_CATEGORY(jsonUtils)
@@ -0,0 +1,7 @@
+include(../../config.pri)
+setupTest(directorywatcher)
+
+include(../../lib/lib.pri)
+
+SOURCES += \
+    test_directorywatcher.cpp
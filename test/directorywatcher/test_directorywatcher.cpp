@@ -0,0 +1,180 @@
+#include "utils/directorywatcher.h"
+
+#include <QDir>
+#include <QFile>
+#include <QObject>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+
+class DirectoryWatcherTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  void initTestCase() {}
+  void init();
+  void testMergeChangeSets();
+  void testReportChanges();
+  void testReportContinuousChanges();
+  void testRemoveDirectory();
+  void cleanup();
+  void cleanupTestCase() {}
+
+private:
+
+  QTemporaryDir *m_dir;
+
+  static bool writeFile(const QString &filename, const QByteArray &content);
+
+};
+
+
+void DirectoryWatcherTest::init()
+{
+    m_dir = new QTemporaryDir();
+}
+
+void DirectoryWatcherTest::testMergeChangeSets()
+{
+    FileChangeSet changes;
+    QVERIFY(changes.isEmpty());
+
+    FileChangeSet other;
+    other.added << "a";
+    other.modified << "b";
+    other.removed << "c";
+    changes.merge(other);
+    QVERIFY(!changes.isEmpty());
+    QCOMPARE(changes.added, QStringList({"a"}));
+    QCOMPARE(changes.modified, QStringList({"b"}));
+    QCOMPARE(changes.removed, QStringList({"c"}));
+
+    other = FileChangeSet();
+    other.modified << "a" << "b";
+    other.removed << "b";
+    other.added << "c";
+    changes.merge(other);
+    QCOMPARE(changes.added, QStringList({"a", "c"}));
+    QCOMPARE(changes.modified, QStringList());
+    QCOMPARE(changes.removed, QStringList({"b"}));
+}
+
+void DirectoryWatcherTest::testReportChanges()
+{
+    QDir dir(m_dir->path());
+    QVERIFY(dir.mkpath("2017/1"));
+    auto existingFile = dir.absoluteFilePath("2017/1/existing.otl");
+    QVERIFY(writeFile(existingFile, "{}"));
+
+    DirectoryWatcher watcher;
+    QSignalSpy filesChanged(&watcher, &DirectoryWatcher::filesChanged);
+    watcher.setDirectory(m_dir->path());
+    QTest::qWait(500);
+    QCOMPARE(filesChanged.count(), 0);
+
+    // Add a file:
+    auto newFile = dir.absoluteFilePath("2017/1/new.otl");
+    QVERIFY(writeFile(newFile, "{}"));
+    QVERIFY(filesChanged.wait(5000));
+    auto changes = filesChanged.takeFirst().at(0).value<FileChangeSet>();
+    QCOMPARE(changes.added, QStringList({newFile}));
+
+    // Modify a file:
+    QVERIFY(writeFile(existingFile, "{\"title\": \"Foo\"}"));
+    QVERIFY(filesChanged.wait(5000));
+    changes = FileChangeSet();
+    while (!filesChanged.isEmpty()) {
+        changes.merge(filesChanged.takeFirst().at(0).value<FileChangeSet>());
+    }
+    QCOMPARE(changes.modified, QStringList({existingFile}));
+
+    // Hidden files are ignored:
+    QVERIFY(writeFile(dir.absoluteFilePath("2017/1/.hidden"), "{}"));
+    QVERIFY(!filesChanged.wait(1000));
+
+    // Remove a file:
+    QVERIFY(QFile::remove(newFile));
+    QVERIFY(filesChanged.wait(5000));
+    changes = filesChanged.takeFirst().at(0).value<FileChangeSet>();
+    QCOMPARE(changes.removed, QStringList({newFile}));
+
+    // New directories are watched as well:
+    QVERIFY(dir.mkpath("2017/2"));
+    auto fileInNewDir = dir.absoluteFilePath("2017/2/item.otl");
+    QVERIFY(writeFile(fileInNewDir, "{}"));
+    changes = FileChangeSet();
+    while (!changes.added.contains(fileInNewDir) && filesChanged.wait(5000)) {
+        while (!filesChanged.isEmpty()) {
+            changes.merge(filesChanged.takeFirst().at(0).value<FileChangeSet>());
+        }
+    }
+    QCOMPARE(changes.added, QStringList({fileInNewDir}));
+}
+
+void DirectoryWatcherTest::testReportContinuousChanges()
+{
+    QDir dir(m_dir->path());
+    QVERIFY(dir.mkpath("2017/1"));
+    auto file = dir.absoluteFilePath("2017/1/item.otl");
+    QVERIFY(writeFile(file, "{}"));
+
+    DirectoryWatcher watcher;
+    QSignalSpy filesChanged(&watcher, &DirectoryWatcher::filesChanged);
+    watcher.setDirectory(m_dir->path());
+    QTest::qWait(500);
+
+    // Changes must be reported while events keep coming in:
+    for (int i = 0; i < 100 && filesChanged.isEmpty(); ++i) {
+        QVERIFY(writeFile(file, QString("{\"title\": \"%1\"}").arg(i).toUtf8()));
+        QTest::qWait(20);
+    }
+    QVERIFY(!filesChanged.isEmpty());
+}
+
+void DirectoryWatcherTest::testRemoveDirectory()
+{
+    QDir dir(m_dir->path());
+    QVERIFY(dir.mkpath("2017/1"));
+    QVERIFY(dir.mkpath("2017/2"));
+    auto file1 = dir.absoluteFilePath("2017/1/item.otl");
+    auto file2 = dir.absoluteFilePath("2017/2/item.otl");
+    QVERIFY(writeFile(file1, "{}"));
+    QVERIFY(writeFile(file2, "{}"));
+
+    DirectoryWatcher watcher;
+    QSignalSpy filesChanged(&watcher, &DirectoryWatcher::filesChanged);
+    watcher.setDirectory(m_dir->path());
+    QTest::qWait(500);
+
+    QVERIFY(QDir(dir.absoluteFilePath("2017")).removeRecursively());
+    FileChangeSet changes;
+    while (changes.removed.length() < 2 && filesChanged.wait(5000)) {
+        while (!filesChanged.isEmpty()) {
+            changes.merge(filesChanged.takeFirst().at(0).value<FileChangeSet>());
+        }
+    }
+    QCOMPARE(changes.removed.toSet(), QSet<QString>({file1, file2}));
+}
+
+void DirectoryWatcherTest::cleanup()
+{
+    delete m_dir;
+}
+
+bool DirectoryWatcherTest::writeFile(const QString &filename, const QByteArray &content)
+{
+    QFile file(filename);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(content);
+        file.close();
+        return true;
+    }
+    return false;
+}
+
+
+QTEST_MAIN(DirectoryWatcherTest)
+#include "test_directorywatcher.moc"
@@ -3,4 +3,6 @@ setupTest(itemcontainer)
 
 include(../../lib/lib.pri)
 
+QT += concurrent
+
 SOURCES +=     test_itemcontainer.cpp
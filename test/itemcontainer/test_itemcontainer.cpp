@@ -2,7 +2,9 @@
 
 #include <QObject>
 #include <QSignalSpy>
+#include <QtConcurrent>
 #include <QTest>
+#include <QThread>
 
 #include "todolist.h"
 #include "todo.h"
@@ -19,10 +21,14 @@ private slots:
   void initTestCase() {}
   void init();
   void testAddItem();
+  void testAddItems();
   void testCount();
   void testUpdateItem();
   void testDeleteItem();
   void testItemChanged();
+  void testRowIndex();
+  void testReadFromOtherThreads();
+  void testSnapshotFollowsSignals();
   void cleanup();
   void cleanupTestCase() {}
 
@@ -68,6 +74,48 @@ void ItemContainerTest::testAddItem()
     }
 }
 
+void ItemContainerTest::testAddItems()
+{
+    ItemContainer c;
+    QSignalSpy itemsAdded(&c, &ItemContainer::itemsAdded);
+    QSignalSpy countChanged(&c, &ItemContainer::countChanged);
+    c.addItems(m_items + m_items);
+    QVERIFY(itemsAdded.wait(1000));
+    QCOMPARE(itemsAdded.count(), 1);
+    QCOMPARE(itemsAdded.at(0).at(0).toInt(), 0);
+    QCOMPARE(itemsAdded.at(0).at(1).toInt(), m_items.count() - 1);
+    QCOMPARE(countChanged.count(), 1);
+    QCOMPARE(c.count(), m_items.count());
+    for (int i = 0; i < m_items.count(); ++i) {
+        QCOMPARE(c.item(i), m_items.at(i));
+    }
+
+    // Items already in the container are updated instead of being added:
+    TaskPtr task(new Task());
+    task->fromVariant(m_task->toVariant());
+    task->setTitle("Updated Task");
+    TaskPtr newTask(new Task());
+    c.updateOrInsertItems({task, newTask});
+    QCOMPARE(m_task->title(), QString("Updated Task"));
+    QVERIFY(itemsAdded.wait(1000));
+    QCOMPARE(itemsAdded.at(1).at(0).toInt(), m_items.count());
+    QCOMPARE(itemsAdded.at(1).at(1).toInt(), m_items.count());
+    QCOMPARE(c.count(), m_items.count() + 1);
+
+    // Items are known right away, even before they have been inserted:
+    TaskPtr anotherTask(new Task());
+    TaskPtr copy(new Task());
+    copy->fromVariant(anotherTask->toVariant());
+    copy->setTitle("Copy");
+    QCOMPARE(c.updateOrInsertItems({anotherTask, copy}),
+             QList<ItemPtr>({anotherTask}));
+    QCOMPARE(anotherTask->title(), QString("Copy"));
+    QCOMPARE(c.updateOrInsertItems({copy}), QList<ItemPtr>());
+    QVERIFY(itemsAdded.wait(1000));
+    QCOMPARE(itemsAdded.count(), 3);
+    QCOMPARE(c.count(), m_items.count() + 2);
+}
+
 void ItemContainerTest::testCount()
 {
     ItemContainer c;
@@ -145,6 +193,101 @@ void ItemContainerTest::testItemChanged()
     QCOMPARE(row.at(0).toInt(), 1);
 }
 
+void ItemContainerTest::testRowIndex()
+{
+    ItemContainer c;
+    QList<ItemPtr> notes;
+    for (int i = 0; i < 100; ++i) {
+        notes << NotePtr(new Note());
+    }
+    QSignalSpy itemsAdded(&c, &ItemContainer::itemsAdded);
+    c.addItems(notes);
+    QVERIFY(itemsAdded.wait(1000));
+
+    // Remove every other item:
+    QSignalSpy itemDeleted(&c, &ItemContainer::itemDeleted);
+    for (int i = 0; i < notes.count(); i += 2) {
+        c.deleteItem(notes.at(i));
+    }
+    while (itemDeleted.count() < 50) {
+        QVERIFY(itemDeleted.wait(1000));
+    }
+    for (int i = 0; i < 50; ++i) {
+        QCOMPARE(itemDeleted.at(i).at(0).toInt(), i);
+    }
+    QCOMPARE(c.count(), 50);
+
+    // Changes are reported for the right rows:
+    QSignalSpy itemChanged(&c, &ItemContainer::itemChanged);
+    notes.at(99)->setTitle("Last");
+    QVERIFY(itemChanged.wait(1000));
+    QCOMPARE(itemChanged.at(0).at(0).toInt(), 49);
+    notes.at(1)->setTitle("First");
+    QVERIFY(itemChanged.wait(1000));
+    QCOMPARE(itemChanged.at(1).at(0).toInt(), 0);
+
+    // Deleted items are not reported any more:
+    notes.at(0)->setTitle("Deleted");
+    QVERIFY(!itemChanged.wait(500));
+
+    // Appending after removals keeps the index consistent:
+    NotePtr note(new Note());
+    QSignalSpy itemAdded(&c, &ItemContainer::itemAdded);
+    c.addItem(note);
+    QVERIFY(itemAdded.wait(1000));
+    QCOMPARE(itemAdded.at(0).at(0).toInt(), 50);
+    note->setTitle("New");
+    QVERIFY(itemChanged.wait(1000));
+    QCOMPARE(itemChanged.at(2).at(0).toInt(), 50);
+}
+
+void ItemContainerTest::testReadFromOtherThreads()
+{
+    ItemContainer c;
+    QSignalSpy itemsAdded(&c, &ItemContainer::itemsAdded);
+    c.addItems(m_items);
+    QVERIFY(itemsAdded.wait(1000));
+    QCOMPARE(c.count(), m_items.count());
+    auto count = QtConcurrent::run([&]() { return c.count(); });
+    QCOMPARE(count.result(), m_items.count());
+    auto item = QtConcurrent::run([&]() { return c.item(1); });
+    QCOMPARE(item.result(), c.item(1));
+    QCOMPARE(c.item(m_items.count()), ItemPtr());
+
+    QSignalSpy itemDeleted(&c, &ItemContainer::itemDeleted);
+    c.deleteItem(m_items.at(0));
+    QVERIFY(itemDeleted.wait(1000));
+    QCOMPARE(c.count(), m_items.count() - 1);
+    QCOMPARE(c.item(0), m_items.at(1));
+}
+
+void ItemContainerTest::testSnapshotFollowsSignals()
+{
+    ItemContainer c;
+    QList<int> counts;
+    connect(&c, &ItemContainer::itemsAdded, [&](int, int) {
+        counts << c.count();
+    });
+    connect(&c, &ItemContainer::itemDeleted, [&](int) {
+        counts << c.count();
+    });
+    QSignalSpy itemsAdded(&c, &ItemContainer::itemsAdded);
+    c.addItems(m_items);
+
+    // The modification must not be visible before it has been reported:
+    QThread::msleep(200);
+    QCOMPARE(c.count(), 0);
+    QVERIFY(itemsAdded.wait(1000));
+    QCOMPARE(c.count(), m_items.count());
+
+    QSignalSpy itemDeleted(&c, &ItemContainer::itemDeleted);
+    c.deleteItem(m_items.at(0));
+    QThread::msleep(200);
+    QCOMPARE(c.count(), m_items.count());
+    QVERIFY(itemDeleted.wait(1000));
+    QCOMPARE(counts, QList<int>({m_items.count(), m_items.count() - 1}));
+}
+
 void ItemContainerTest::cleanup()
 {
     m_todoList.clear();
@@ -0,0 +1,7 @@
+include(../../config.pri)
+setupTest(itemrecordstore)
+
+include(../../lib/lib.pri)
+
+SOURCES += \
+    test_itemrecordstore.cpp
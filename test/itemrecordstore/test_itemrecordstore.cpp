@@ -0,0 +1,477 @@
+#include "itemrecordstore.h"
+
+#include "itemcontainer.h"
+#include "itemsmodel.h"
+#include "itemwriter.h"
+#include "library.h"
+#include "note.h"
+#include "task.h"
+#include "todo.h"
+#include "todolist.h"
+#include "utils/jsonutils.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QObject>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+
+class ItemRecordStoreTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  void initTestCase() {}
+  void init();
+  void testLoadRecords();
+  void testLoad();
+  void testItem();
+  void testCacheSize();
+  void testRecordChanged();
+  void testItemsModel();
+  void testNotes();
+  void testUpdateRecords();
+  void testLibrary();
+  void testEditLibraryItems();
+  void benchmarkMemory();
+  void cleanup();
+  void cleanupTestCase() {}
+
+private:
+
+  QTemporaryDir *m_dir;
+
+  void createLibrary();
+  void createNotes(int numItems);
+
+};
+
+
+void ItemRecordStoreTest::init()
+{
+    m_dir = new QTemporaryDir();
+}
+
+void ItemRecordStoreTest::testLoadRecords()
+{
+    createLibrary();
+    auto records = ItemRecordStore::loadRecords(m_dir->path());
+    QCOMPARE(records.count(), 5);
+    int notes = 0;
+    for (auto record : records) {
+        QVERIFY(!record.uid.isNull());
+        QVERIFY(!record.filename.isEmpty());
+        if (record.itemType == "Note") {
+            ++notes;
+            QVERIFY(record.title.startsWith("Note "));
+            QCOMPARE(record.tags, QStringList({"Foo"}));
+        } else if (record.itemType == "Task") {
+            QCOMPARE(record.title, QString("A Task"));
+            QVERIFY(record.done);
+            QVERIFY(!record.parentUid.isNull());
+        } else if (record.itemType == "Todo") {
+            QCOMPARE(record.title, QString("A Todo"));
+            QVERIFY(!record.parentUid.isNull());
+        }
+    }
+    QCOMPARE(notes, 2);
+}
+
+void ItemRecordStoreTest::testLoad()
+{
+    createLibrary();
+    ItemRecordStore store;
+    QSignalSpy loadingChanged(&store, &ItemRecordStore::loadingChanged);
+    store.load(m_dir->path());
+    QVERIFY(store.loading());
+    QVERIFY(loadingChanged.wait());
+    QVERIFY(!store.loading());
+    QCOMPARE(store.count(), 5);
+    QCOMPARE(store.materializedCount(), 0);
+    for (int i = 0; i < store.count(); ++i) {
+        auto record = store.record(i);
+        QCOMPARE(store.indexOf(record.uid), i);
+        QCOMPARE(store.uid(i), record.uid);
+        QCOMPARE(store.itemType(i), record.itemType);
+        QCOMPARE(store.done(i), record.done);
+        QCOMPARE(store.parentUid(i), record.parentUid);
+        if (record.itemType == "Todo") {
+            QCOMPARE(store.kind(i), ItemRecordStore::TodoRecord);
+        } else if (record.itemType == "Task") {
+            QCOMPARE(store.kind(i), ItemRecordStore::TaskRecord);
+        } else {
+            QCOMPARE(store.kind(i), ItemRecordStore::TopLevelRecord);
+        }
+    }
+    QCOMPARE(store.kind(-1), ItemRecordStore::TopLevelRecord);
+    QVERIFY(store.uid(store.count()).isNull());
+}
+
+void ItemRecordStoreTest::testItem()
+{
+    createLibrary();
+    ItemRecordStore store;
+    store.addRecords(ItemRecordStore::loadRecords(m_dir->path()));
+    QCOMPARE(store.materializedCount(), 0);
+    auto item = store.item(0);
+    QVERIFY(!item.isNull());
+    QCOMPARE(item->uid(), store.record(0).uid);
+    QCOMPARE(item->title(), store.record(0).title);
+    QCOMPARE(store.materializedCount(), 1);
+    QCOMPARE(store.item(0), item);
+    QCOMPARE(store.materializedCount(), 1);
+    QVERIFY(store.item(-1).isNull());
+    QVERIFY(store.item(store.count()).isNull());
+}
+
+void ItemRecordStoreTest::testCacheSize()
+{
+    createLibrary();
+    ItemRecordStore store;
+    store.addRecords(ItemRecordStore::loadRecords(m_dir->path()));
+    store.setCacheSize(2);
+    QSignalSpy itemReleased(&store, &ItemRecordStore::itemReleased);
+    store.item(0);
+    store.item(1);
+    QCoreApplication::processEvents();
+    QCOMPARE(itemReleased.count(), 0);
+    store.item(0);
+    store.item(2);
+    // Items are released only once control returns to the event loop:
+    QCOMPARE(itemReleased.count(), 0);
+    QCOMPARE(store.materializedCount(), 3);
+    QCoreApplication::processEvents();
+    QCOMPARE(itemReleased.count(), 1);
+    QCOMPARE(itemReleased.at(0).at(0).toInt(), 1);
+    QCOMPARE(store.materializedCount(), 2);
+    store.setCacheSize(1);
+    QCoreApplication::processEvents();
+    QCOMPARE(itemReleased.count(), 2);
+    QCOMPARE(itemReleased.at(1).at(0).toInt(), 0);
+    QCOMPARE(store.materializedCount(), 1);
+
+    // Items requested at once are kept, even if they exceed the cache:
+    for (int i = 0; i < store.count(); ++i) {
+        store.item(i);
+    }
+    QCoreApplication::processEvents();
+    QCOMPARE(itemReleased.count(), 2);
+    QCOMPARE(store.materializedCount(), store.count());
+    store.item(4);
+    QCoreApplication::processEvents();
+    QCOMPARE(itemReleased.count(), 6);
+    QCOMPARE(store.materializedCount(), 1);
+}
+
+void ItemRecordStoreTest::testRecordChanged()
+{
+    createLibrary();
+    ItemRecordStore store;
+    store.addRecords(ItemRecordStore::loadRecords(m_dir->path()));
+    store.setCacheSize(1);
+    QSignalSpy recordChanged(&store, &ItemRecordStore::recordChanged);
+    auto item = store.item(3);
+    item->setTitle("Changed");
+    QVERIFY(recordChanged.count() > 0);
+    QCOMPARE(recordChanged.last().at(0).toInt(), 3);
+    QCOMPARE(store.record(3).title, QString("Changed"));
+
+    // Releasing the item must not lose the change:
+    item.reset();
+    QCoreApplication::processEvents();
+    store.item(0);
+    QCoreApplication::processEvents();
+    QCOMPARE(store.materializedCount(), 1);
+    QCOMPARE(store.item(3)->title(), QString("Changed"));
+}
+
+void ItemRecordStoreTest::testItemsModel()
+{
+    createLibrary();
+    ItemRecordStore store;
+    store.addRecords(ItemRecordStore::loadRecords(m_dir->path()));
+    ItemsModel model;
+    ItemContainer container;
+    model.setContainer(&container);
+    QSignalSpy countChanged(&model, &ItemsModel::countChanged);
+    QSignalSpy containerChanged(&model, &ItemsModel::containerChanged);
+    model.setRecords(&store);
+    QCOMPARE(countChanged.count(), 2);
+    // The container and records are mutually exclusive:
+    QCOMPARE(containerChanged.count(), 1);
+    QVERIFY(model.container() == nullptr);
+    QCOMPARE(model.rowCount(), 5);
+    for (int i = 0; i < model.rowCount(); ++i) {
+        auto index = model.index(i, 0);
+        auto record = store.record(i);
+        QCOMPARE(model.data(index, ItemsModel::UidRole).toUuid(), record.uid);
+        QCOMPARE(model.data(index, ItemsModel::ItemTypeRole).toString(),
+                 record.itemType);
+        QCOMPARE(model.data(index, ItemsModel::WeightRole).toDouble(),
+                 record.weight);
+    }
+    QCOMPARE(store.materializedCount(), 0);
+    auto object = model.data(model.index(2, 0), ItemsModel::ItemRole)
+            .value<QObject*>();
+    auto item = qobject_cast<Item*>(object);
+    QVERIFY(item != nullptr);
+    QCOMPARE(item->uid(), store.record(2).uid);
+    QCOMPARE(store.materializedCount(), 1);
+
+    QSignalSpy dataChanged(&model, &ItemsModel::dataChanged);
+    item->setTitle("Changed");
+    QVERIFY(dataChanged.count() > 0);
+    QCOMPARE(dataChanged.last().at(0).toModelIndex().row(), 2);
+
+    store.clear();
+    QCOMPARE(model.rowCount(), 0);
+
+    model.setContainer(&container);
+    QVERIFY(model.records() == nullptr);
+    store.addRecords(ItemRecordStore::loadRecords(m_dir->path()));
+    QCOMPARE(model.rowCount(), 0);
+}
+
+void ItemRecordStoreTest::testNotes()
+{
+    createLibrary();
+    ItemRecordStore store;
+    store.addRecords(ItemRecordStore::loadRecords(m_dir->path()));
+    int index = -1;
+    for (int i = 0; i < store.count(); ++i) {
+        if (store.record(i).itemType == "Note") {
+            index = i;
+            break;
+        }
+    }
+    QVERIFY(index >= 0);
+    QCOMPARE(store.notes(index), QString("Some notes"));
+    QCOMPARE(store.materializedCount(), 0);
+
+    // Notes are read from the file only once:
+    auto filename = store.record(index).filename;
+    QVERIFY(JsonUtils::patchJsonFile(filename, {{"notes", "Changed on disk"}}));
+    QCOMPARE(store.notes(index), QString("Some notes"));
+
+    auto note = store.item(index).objectCast<Note>();
+    QVERIFY(!note.isNull());
+    note->setNotes("Other notes");
+    QCOMPARE(store.notes(index), QString("Other notes"));
+    QVERIFY(store.notes(-1).isEmpty());
+}
+
+void ItemRecordStoreTest::testUpdateRecords()
+{
+    ItemRecordStore store;
+    QVector<ItemRecord> records;
+    for (int i = 0; i < 3; ++i) {
+        ItemRecord record;
+        record.uid = QUuid::createUuid();
+        record.itemType = "Note";
+        record.filename = QString("/library/2017/1/%1.otl").arg(i);
+        record.title = QString("Note %1").arg(i);
+        record.weight = i;
+        record.tags = QStringList({"Foo", "Bar"});
+        records << record;
+    }
+    store.addRecords(records);
+    QCOMPARE(store.count(), 3);
+    for (int i = 0; i < 3; ++i) {
+        auto record = store.record(i);
+        QCOMPARE(record.uid, records[i].uid);
+        QCOMPARE(record.itemType, records[i].itemType);
+        QCOMPARE(record.filename, records[i].filename);
+        QCOMPARE(record.title, records[i].title);
+        QCOMPARE(record.weight, records[i].weight);
+        QCOMPARE(record.tags, records[i].tags);
+        QCOMPARE(store.weight(i), records[i].weight);
+        QCOMPARE(store.tags(i), records[i].tags);
+    }
+
+    // Adding a record twice is ignored:
+    store.addRecords({records[0]});
+    QCOMPARE(store.count(), 3);
+
+    // Storing records repeatedly must not grow the memory used without
+    // bounds:
+    createNotes(1);
+    store.clear();
+    store.addRecords(ItemRecordStore::loadRecords(m_dir->path()));
+    auto note = store.item(0).objectCast<Note>();
+    QVERIFY(!note.isNull());
+    note->setTags({"Foo"});
+    for (int i = 0; i < 10000; ++i) {
+        note->setTitle(QString("Title %1").arg(i));
+    }
+    QCOMPARE(store.record(0).title, QString("Title 9999"));
+    QCOMPARE(store.record(0).tags, QStringList({"Foo"}));
+    QVERIFY(store.memoryUsage() < 100000);
+}
+
+void ItemRecordStoreTest::testLibrary()
+{
+    createLibrary();
+    Library lib(m_dir->path());
+    ItemRecordStore store;
+    QSignalSpy loadingChanged(&store, &ItemRecordStore::loadingChanged);
+    store.setLibrary(&lib);
+    QCOMPARE(store.library(), &lib);
+    QVERIFY(store.loading());
+
+    // Items added while loading are kept:
+    auto note = lib.addNote();
+    note->setTitle("New Note");
+    QVERIFY(loadingChanged.wait());
+    QVERIFY(!store.loading());
+    QCOMPARE(store.count(), 6);
+    auto index = store.indexOf(note->uid());
+    QVERIFY(index >= 0);
+    QCOMPARE(store.record(index).title, QString("New Note"));
+
+    // Changes of items in the library are reflected:
+    note->setTitle("Changed");
+    QCOMPARE(store.record(index).title, QString("Changed"));
+
+    // The store hands out the items of the library:
+    QCOMPARE(store.item(index).data(), static_cast<Item*>(note));
+    QCOMPARE(store.materializedCount(), 0);
+
+    // Deleted items are removed:
+    QSignalSpy recordRemoved(&store, &ItemRecordStore::recordRemoved);
+    note->deleteItem();
+    QCOMPARE(recordRemoved.count(), 1);
+    QCOMPARE(store.count(), 5);
+    QCOMPARE(store.indexOf(note->uid()), -1);
+
+    // Items added to the library are added:
+    lib.addNote()->setTitle("Another Note");
+    QCOMPARE(store.count(), 6);
+
+    // Items whose files are removed are removed:
+    ItemWriter::instance()->flush();
+    auto uid1 = store.record(0).uid;
+    auto uid2 = store.record(2).uid;
+    QVERIFY(QFile::remove(store.record(0).filename));
+    QVERIFY(QFile::remove(store.record(2).filename));
+    QTRY_COMPARE_WITH_TIMEOUT(store.count(), 4, 15000);
+    QCOMPARE(store.indexOf(uid1), -1);
+    QCOMPARE(store.indexOf(uid2), -1);
+    for (int i = 0; i < store.count(); ++i) {
+        QCOMPARE(store.indexOf(store.uid(i)), i);
+    }
+
+    store.setLibrary(nullptr);
+    QCOMPARE(store.count(), 0);
+    lib.addNote();
+    QCOMPARE(store.count(), 0);
+}
+
+void ItemRecordStoreTest::testEditLibraryItems()
+{
+    createLibrary();
+    Library lib(m_dir->path());
+    QVERIFY(lib.load());
+    QTRY_VERIFY(!lib.loading());
+    ItemRecordStore store;
+    store.setLibrary(&lib);
+    QTRY_VERIFY(!store.loading());
+    QCOMPARE(store.count(), 5);
+
+    for (int i = 0; i < store.count(); ++i) {
+        QTRY_VERIFY(!store.item(i).isNull());
+        auto item = store.item(i);
+        item->setTitle(QString("Edited %1").arg(i));
+    }
+    QCOMPARE(store.materializedCount(), 0);
+    for (int i = 0; i < store.count(); ++i) {
+        auto uid = store.uid(i);
+        auto title = QString("Edited %1").arg(i);
+        QCOMPARE(store.record(i).title, title);
+        ItemPtr libraryItem;
+        for (auto container : {lib.topLevelItems(), lib.todos(), lib.tasks()}) {
+            if (libraryItem.isNull()) {
+                libraryItem = container->findItem(uid);
+            }
+        }
+        QVERIFY(!libraryItem.isNull());
+        QCOMPARE(libraryItem->title(), title);
+        ItemWriter::instance()->flush(libraryItem->filename());
+        QCOMPARE(JsonUtils::loadMap(libraryItem->filename())
+                 .value("title").toString(), title);
+    }
+}
+
+void ItemRecordStoreTest::benchmarkMemory()
+{
+    int numItems = qEnvironmentVariableIsSet("OTL_BENCHMARK_ITEMS") ?
+                qgetenv("OTL_BENCHMARK_ITEMS").toInt() : 1000;
+    createNotes(numItems);
+    auto records = ItemRecordStore::loadRecords(m_dir->path());
+    QCOMPARE(records.count(), numItems);
+
+    // Estimate the memory used when holding the records as they are:
+    auto stringSize = [](const QString &string) {
+        return static_cast<int>(sizeof(QArrayData)) +
+                (string.capacity() + 1) * static_cast<int>(sizeof(QChar));
+    };
+    int plainSize = records.capacity() * static_cast<int>(sizeof(ItemRecord));
+    for (const auto &record : records) {
+        plainSize += stringSize(record.itemType) + stringSize(record.filename) +
+                stringSize(record.title);
+        for (const auto &tag : record.tags) {
+            plainSize += static_cast<int>(sizeof(QString)) + stringSize(tag);
+        }
+    }
+
+    ItemRecordStore store;
+    QBENCHMARK_ONCE {
+        store.addRecords(records);
+    }
+    int compactSize = store.memoryUsage();
+    qInfo() << "Bytes per item:" << plainSize / numItems << "(plain records),"
+            << compactSize / numItems << "(compact records)";
+    QVERIFY(compactSize < plainSize);
+}
+
+void ItemRecordStoreTest::cleanup()
+{
+    delete m_dir;
+}
+
+void ItemRecordStoreTest::createLibrary()
+{
+    Library lib(m_dir->path());
+    for (int i = 0; i < 2; ++i) {
+        auto note = lib.addNote();
+        note->setTitle(QString("Note %1").arg(i));
+        note->setTags({"Foo"});
+        note->setNotes("Some notes");
+    }
+    auto todoList = lib.addTodoList();
+    todoList->setTitle("A Todo List");
+    auto todo = todoList->addTodo();
+    todo->setTitle("A Todo");
+    auto task = todo->addTask();
+    task->setTitle("A Task");
+    task->setDone(true);
+    ItemWriter::instance()->flush();
+}
+
+void ItemRecordStoreTest::createNotes(int numItems)
+{
+    Library lib(m_dir->path());
+    for (int i = 0; i < numItems; ++i) {
+        auto note = lib.addNote();
+        note->setTitle(QString("Note %1").arg(i));
+        note->setNotes("Lorem ipsum dolor sit amet, consectetur adipiscing elit.");
+        note->setTags({"Foo", "Bar"});
+    }
+    ItemWriter::instance()->flush();
+}
+
+
+QTEST_MAIN(ItemRecordStoreTest)
+#include "test_itemrecordstore.moc"
@@ -5,6 +5,8 @@
 #include <QTest>
 
 #include "note.h"
+#include "task.h"
+#include "todo.h"
 
 class ItemsModelTest : public QObject
 {
@@ -15,7 +17,9 @@ private slots:
   void initTestCase() {}
   void init();
   void testAddItems();
+  void testBulkAddItems();
   void testDeleteItems();
+  void testRoles();
   void cleanup();
   void cleanupTestCase() {}
 
@@ -48,6 +52,24 @@ void ItemsModelTest::testAddItems()
     QCOMPARE(rowsInserted.at(1).at(1).toInt(), 1);
 }
 
+void ItemsModelTest::testBulkAddItems()
+{
+    NotePtr note1(new Note());
+    QSignalSpy rowsInserted(m_model, &ItemsModel::rowsInserted);
+    m_container->addItem(note1);
+    QVERIFY(rowsInserted.wait(1000));
+    QList<ItemPtr> notes;
+    for (int i = 0; i < 10; ++i) {
+        notes << NotePtr(new Note());
+    }
+    m_container->addItems(notes);
+    QVERIFY(rowsInserted.wait(1000));
+    QCOMPARE(rowsInserted.count(), 2);
+    QCOMPARE(rowsInserted.at(1).at(1).toInt(), 1);
+    QCOMPARE(rowsInserted.at(1).at(2).toInt(), 10);
+    QCOMPARE(m_model->rowCount(QModelIndex()), 11);
+}
+
 void ItemsModelTest::testDeleteItems()
 {
     NotePtr note1(new Note());
@@ -74,6 +96,39 @@ void ItemsModelTest::testDeleteItems()
     QCOMPARE(rowsRemoved.at(2).at(1).toInt(), 0);
 }
 
+void ItemsModelTest::testRoles()
+{
+    NotePtr note(new Note());
+    note->addTag("Foo");
+    TodoPtr todo(new Todo());
+    todo->setDone(true);
+    todo->setTodoListUid(QUuid::createUuid());
+    TaskPtr task(new Task());
+    task->setTodoUid(todo->uid());
+
+    QSignalSpy rowsInserted(m_model, &ItemsModel::rowsInserted);
+    m_container->addItems({note, todo, task});
+    QVERIFY(rowsInserted.wait(1000));
+    QCOMPARE(m_model->rowCount(QModelIndex()), 3);
+
+    auto noteIndex = m_model->index(0, 0);
+    auto todoIndex = m_model->index(1, 0);
+    auto taskIndex = m_model->index(2, 0);
+
+    QCOMPARE(noteIndex.data(ItemsModel::ItemTypeRole).toString(), QString("Note"));
+    QCOMPARE(noteIndex.data(ItemsModel::TagsRole).toStringList(), QStringList({"Foo"}));
+    QVERIFY(!noteIndex.data(ItemsModel::DoneRole).isValid());
+
+    QCOMPARE(todoIndex.data(ItemsModel::ItemTypeRole).toString(), QString("Todo"));
+    QCOMPARE(todoIndex.data(ItemsModel::DoneRole).toBool(), true);
+    QCOMPARE(todoIndex.data(ItemsModel::TodoListUidRole).toUuid(), todo->todoListUid());
+    QVERIFY(!todoIndex.data(ItemsModel::TodoUidRole).isValid());
+
+    QCOMPARE(taskIndex.data(ItemsModel::ItemTypeRole).toString(), QString("Task"));
+    QCOMPARE(taskIndex.data(ItemsModel::DoneRole).toBool(), false);
+    QCOMPARE(taskIndex.data(ItemsModel::TodoUidRole).toUuid(), todo->uid());
+}
+
 void ItemsModelTest::cleanup()
 {
     delete m_model;
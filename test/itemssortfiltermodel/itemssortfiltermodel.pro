@@ -0,0 +1,7 @@
+include(../../config.pri)
+setupTest(itemssortfiltermodel)
+
+include(../../lib/lib.pri)
+
+SOURCES += \
+    test_itemssortfiltermodel.cpp
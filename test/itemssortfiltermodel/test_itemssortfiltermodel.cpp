@@ -0,0 +1,210 @@
+#include "itemssortfiltermodel.h"
+
+#include <QObject>
+#include <QSignalSpy>
+#include <QTest>
+
+#include "itemcontainer.h"
+#include "itemsmodel.h"
+#include "library.h"
+#include "note.h"
+
+
+class ItemsSortFilterModelTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  void initTestCase() {}
+  void testSearch();
+  void testSearchWithLibrary();
+  void testCancelSearch();
+  void testSortByWeight();
+  void testTagFilter_data();
+  void testTagFilter();
+  void benchmarkLoad();
+  void cleanupTestCase() {}
+
+};
+
+
+void ItemsSortFilterModelTest::testSearch()
+{
+    Library lib;
+    lib.addNote()->setTitle("Buy milk");
+    lib.addNote()->setTitle("Bake bread");
+    ItemsModel model;
+    model.setContainer(lib.topLevelItems());
+    ItemsSortFilterModel filter;
+    filter.setSourceModel(&model);
+    QTRY_COMPARE(filter.count(), 2);
+
+    filter.setSearchString("milk");
+    QVERIFY(!filter.searching());
+    QCOMPARE(filter.count(), 1);
+}
+
+void ItemsSortFilterModelTest::testSearchWithLibrary()
+{
+    Library lib;
+    lib.addNote()->setTitle("Buy milk");
+    lib.addNote()->setTitle("Bake bread");
+    ItemsModel model;
+    model.setContainer(lib.topLevelItems());
+    ItemsSortFilterModel filter;
+    filter.setSourceModel(&model);
+    filter.setLibrary(&lib);
+    QTRY_COMPARE(filter.count(), 2);
+
+    QSignalSpy searchingChanged(&filter, &ItemsSortFilterModel::searchingChanged);
+    filter.setSearchString("milk");
+    QVERIFY(filter.searching());
+    // Until the first results arrive, the previous filter state is kept:
+    filter.invalidate();
+    QCOMPARE(filter.count(), 2);
+    QVERIFY(searchingChanged.wait(1000));
+    QVERIFY(!filter.searching());
+    QCOMPARE(filter.count(), 1);
+
+    // Changes of the index are collected before searching again:
+    lib.addNote()->setTitle("Milkshake");
+    lib.addNote()->setTitle("Milk");
+    QTRY_COMPARE(filter.count(), 3);
+    QCOMPARE(searchingChanged.count(), 4);
+
+    filter.setSearchString("");
+    QVERIFY(!filter.searching());
+    QCOMPARE(filter.count(), 4);
+}
+
+void ItemsSortFilterModelTest::testCancelSearch()
+{
+    Library lib;
+    for (int i = 0; i < 100; ++i) {
+        lib.addNote()->setTitle(QString("Note %1").arg(i));
+    }
+    lib.addNote()->setTitle("Buy milk");
+    ItemsModel model;
+    model.setContainer(lib.topLevelItems());
+    ItemsSortFilterModel filter;
+    filter.setSourceModel(&model);
+    filter.setLibrary(&lib);
+    QTRY_COMPARE(filter.count(), 101);
+
+    QSignalSpy searchingChanged(&filter, &ItemsSortFilterModel::searchingChanged);
+    filter.setSearchString("n");
+    filter.setSearchString("no");
+    filter.setSearchString("mi");
+    QVERIFY(searchingChanged.wait(1000));
+    QCOMPARE(searchingChanged.count(), 2);
+    QCOMPARE(filter.count(), 1);
+}
+
+void ItemsSortFilterModelTest::testSortByWeight()
+{
+    ItemContainer container;
+    NotePtr note1(new Note());
+    NotePtr note2(new Note());
+    NotePtr note3(new Note());
+    note1->setWeight(3);
+    note2->setWeight(1);
+    note3->setWeight(2);
+    container.addItems({note1, note2, note3});
+    ItemsModel model;
+    model.setContainer(&container);
+    ItemsSortFilterModel filter;
+    filter.setSourceModel(&model);
+    QTRY_COMPARE(filter.count(), 3);
+
+    auto itemAt = [&](int row) {
+        return filter.data(filter.index(row, 0), ItemsModel::ItemRole)
+                .value<QObject*>();
+    };
+    QCOMPARE(itemAt(0), note2.data());
+    QCOMPARE(itemAt(1), note3.data());
+    QCOMPARE(itemAt(2), note1.data());
+
+    NotePtr note4(new Note());
+    note4->setWeight(1.5);
+    container.addItem(note4);
+    QTRY_COMPARE(filter.count(), 4);
+    QCOMPARE(itemAt(1), note4.data());
+
+    note1->setTitle("Changed");
+    note2->setWeight(4);
+    QTRY_COMPARE(itemAt(3), note2.data());
+    QCOMPARE(itemAt(0), note4.data());
+    QCOMPARE(itemAt(1), note3.data());
+    QCOMPARE(itemAt(2), note1.data());
+}
+
+void ItemsSortFilterModelTest::testTagFilter_data()
+{
+    QTest::addColumn<bool>("useLibrary");
+    QTest::newRow("Without library") << false;
+    QTest::newRow("With library") << true;
+}
+
+void ItemsSortFilterModelTest::testTagFilter()
+{
+    QFETCH(bool, useLibrary);
+    Library lib;
+    auto note1 = lib.addNote();
+    auto note2 = lib.addNote();
+    auto note3 = lib.addNote();
+    note1->setTags({"Foo", "Bar"});
+    note2->setTags({"Foo"});
+    ItemsModel model;
+    model.setContainer(lib.topLevelItems());
+    ItemsSortFilterModel filter;
+    filter.setSourceModel(&model);
+    if (useLibrary) {
+        filter.setLibrary(&lib);
+    }
+    QTRY_COMPARE(filter.count(), 3);
+
+    filter.setTag("Foo");
+    QCOMPARE(filter.count(), 2);
+    filter.setTags({"Bar"});
+    QCOMPARE(filter.count(), 1);
+    filter.setMatchAllTags(false);
+    QCOMPARE(filter.count(), 2);
+
+    note3->addTag("Bar");
+    QTRY_COMPARE(filter.count(), 3);
+
+    filter.setTag(QString());
+    filter.setTags({});
+    QCOMPARE(filter.count(), 3);
+}
+
+void ItemsSortFilterModelTest::benchmarkLoad()
+{
+    int numItems = qEnvironmentVariableIsSet("OTL_BENCHMARK_ITEMS") ?
+                qgetenv("OTL_BENCHMARK_ITEMS").toInt() : 10000;
+    QList<QList<ItemPtr>> chunks;
+    for (int i = 0; i < numItems; i += 64) {
+        QList<ItemPtr> chunk;
+        for (int j = i; j < qMin(i + 64, numItems); ++j) {
+            NotePtr note(new Note());
+            note->setWeight(numItems - j);
+            chunk << note;
+        }
+        chunks << chunk;
+    }
+    ItemContainer container;
+    ItemsModel model;
+    model.setContainer(&container);
+    ItemsSortFilterModel filter;
+    filter.setSourceModel(&model);
+    QBENCHMARK_ONCE {
+        for (auto chunk : chunks) {
+            container.addItems(chunk);
+        }
+        QTRY_COMPARE_WITH_TIMEOUT(filter.count(), numItems, 60000);
+    }
+}
+
+QTEST_MAIN(ItemsSortFilterModelTest)
+#include "test_itemssortfiltermodel.moc"
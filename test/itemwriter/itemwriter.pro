@@ -0,0 +1,6 @@
+include(../../config.pri)
+setupTest(itemwriter)
+
+include(../../lib/lib.pri)
+
+SOURCES +=     test_itemwriter.cpp
@@ -0,0 +1,126 @@
+#include "itemwriter.h"
+
+#include "item.h"
+#include "utils/jsonutils.h"
+
+#include <QDir>
+#include <QObject>
+#include <QTemporaryDir>
+#include <QTest>
+
+
+class ItemWriterTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  void initTestCase() {}
+  void init();
+  void testSchedule();
+  void testMergeChanges();
+  void testFlushSingleFile();
+  void testCancel();
+  void testItemSetters();
+  void cleanup();
+  void cleanupTestCase() {}
+
+private:
+
+  QTemporaryDir *m_dir;
+
+};
+
+
+void ItemWriterTest::init()
+{
+    m_dir = new QTemporaryDir();
+}
+
+void ItemWriterTest::testSchedule()
+{
+    ItemWriter writer;
+    writer.setDelay(10);
+    auto filename = m_dir->path() + "/test.json";
+    QVariantMap data;
+    data["Foo"] = "Bar";
+    writer.schedule(filename, data);
+    QVERIFY(writer.hasPendingWrites());
+    int countdown = 100;
+    while (writer.hasPendingWrites() && --countdown > 0) {
+        QThread::msleep(10);
+    }
+    QVERIFY(countdown > 0);
+    // Make sure the background write ran through:
+    QVERIFY(writer.flush());
+    QCOMPARE(JsonUtils::loadMap(filename).value("Foo").toString(),
+             QString("Bar"));
+}
+
+void ItemWriterTest::testMergeChanges()
+{
+    ItemWriter writer;
+    writer.setDelay(10000);
+    auto filename = m_dir->path() + "/test.json";
+    QVariantMap data;
+    data["Foo"] = "Bar";
+    writer.schedule(filename, data);
+    data["Foo"] = "Baz";
+    data["Value"] = 42;
+    writer.schedule(filename, data);
+    QVERIFY(!QFile::exists(filename));
+    QVERIFY(writer.flush());
+    QVERIFY(!writer.hasPendingWrites());
+    auto map = JsonUtils::loadMap(filename);
+    QCOMPARE(map.value("Foo").toString(), QString("Baz"));
+    QCOMPARE(map.value("Value").toInt(), 42);
+}
+
+void ItemWriterTest::testFlushSingleFile()
+{
+    ItemWriter writer;
+    writer.setDelay(10000);
+    auto filename1 = m_dir->path() + "/test1.json";
+    auto filename2 = m_dir->path() + "/test2.json";
+    writer.schedule(filename1, QVariantMap({{"Foo", "Bar"}}));
+    writer.schedule(filename2, QVariantMap({{"Foo", "Baz"}}));
+    QVERIFY(writer.flush(filename1));
+    QVERIFY(QFile::exists(filename1));
+    QVERIFY(!QFile::exists(filename2));
+    QVERIFY(writer.hasPendingWrites());
+    QVERIFY(writer.flush());
+    QVERIFY(QFile::exists(filename2));
+}
+
+void ItemWriterTest::testCancel()
+{
+    ItemWriter writer;
+    writer.setDelay(10000);
+    auto filename = m_dir->path() + "/test.json";
+    writer.schedule(filename, QVariantMap({{"Foo", "Bar"}}));
+    writer.cancel(filename);
+    QVERIFY(!writer.hasPendingWrites());
+    QVERIFY(writer.flush());
+    QVERIFY(!QFile::exists(filename));
+}
+
+void ItemWriterTest::testItemSetters()
+{
+    Item item(QDir(m_dir->path()));
+    QVERIFY(item.save());
+    item.setTitle("Hello");
+    item.setTitle("Hello World");
+    item.setWeight(2.0);
+    QVERIFY(ItemWriter::instance()->flush());
+    auto map = JsonUtils::loadMap(item.filename());
+    QCOMPARE(map.value("title").toString(), QString("Hello World"));
+    QCOMPARE(map.value("weight").toDouble(), 2.0);
+}
+
+void ItemWriterTest::cleanup()
+{
+    delete m_dir;
+}
+
+QTEST_MAIN(ItemWriterTest)
+#include "test_itemwriter.moc"
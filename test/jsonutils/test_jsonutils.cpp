@@ -1,14 +1,17 @@
 #include "utils/jsonutils.h"
 
+#include <QDir>
 #include <QFile>
 #include <QObject>
 #include <QRegularExpression>
 #include <QTemporaryDir>
 #include <QTest>
+#include <QtConcurrent>
 
 
 using JsonUtils::patchJsonFile;
 using JsonUtils::loadMap;
+using JsonUtils::JsonFileCache;
 
 
 class JsonUtilsTest : public QObject
@@ -24,6 +27,11 @@ private slots:
   void testLoadMapWithNonExistingFile();
   void testLoadMapWithInvalidFile();
   void testPatchJsonFile();
+  void testPatchJsonFileWithCache();
+  void testPatchJsonFileIsAtomic();
+  void testRecoverTempFiles();
+  void testConcurrentWrites();
+  void testKeepPermissions();
   void cleanup() {}
   void cleanupTestCase() {}
 };
@@ -93,5 +101,153 @@ void JsonUtilsTest::testPatchJsonFile()
     QCOMPARE(merged.value("Bar").toString(), QString("Baz"));
 }
 
+void JsonUtilsTest::testPatchJsonFileWithCache()
+{
+    QTemporaryDir tempDir;
+    auto filename = tempDir.path() + "/test.json";
+    JsonFileCache cache;
+    QVariantMap v1;
+    v1["Foo"] = "Hello";
+    QVERIFY(patchJsonFile(filename, v1, &cache));
+    QVERIFY(cache.matches(filename));
+    QCOMPARE(cache.properties.value("Foo").toString(), QString("Hello"));
+
+    // Modify the file behind the back of the cache:
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(QString("{ \"Foo\": \"Hello\", \"Unknown\": 42 }").toUtf8());
+    file.close();
+    QVERIFY(!cache.matches(filename));
+
+    // Unknown properties must be kept:
+    QVariantMap v2;
+    v2["Bar"] = "World";
+    QVERIFY(patchJsonFile(filename, v2, &cache));
+    auto merged = loadMap(filename);
+    QCOMPARE(merged.value("Foo").toString(), QString("Hello"));
+    QCOMPARE(merged.value("Bar").toString(), QString("World"));
+    QCOMPARE(merged.value("Unknown").toInt(), 42);
+    QVERIFY(cache.matches(filename));
+
+    JsonFileCache anotherCache;
+    bool ok;
+    loadMap(filename, &ok, &anotherCache);
+    QVERIFY(ok);
+    QVERIFY(anotherCache.matches(filename));
+    QCOMPARE(anotherCache.properties.value("Unknown").toInt(), 42);
+}
+
+void JsonUtilsTest::testPatchJsonFileIsAtomic()
+{
+    QTemporaryDir tempDir;
+    auto filename = tempDir.path() + "/test.json";
+    for (auto policy : {JsonUtils::NoSync, JsonUtils::SyncPerBatch,
+         JsonUtils::SyncPerFile}) {
+        JsonUtils::setSyncPolicy(policy);
+        QVariantMap v;
+        v["Policy"] = static_cast<int>(policy);
+        QVERIFY(patchJsonFile(filename, v));
+        QCOMPARE(loadMap(filename).value("Policy").toInt(),
+                 static_cast<int>(policy));
+        // No temporary files must be left over:
+        QCOMPARE(QDir(tempDir.path()).entryList(
+                     QDir::Files | QDir::Hidden).length(), 1);
+    }
+    JsonUtils::setSyncPolicy(JsonUtils::NoSync);
+}
+
+void JsonUtilsTest::testRecoverTempFiles()
+{
+    QTemporaryDir tempDir;
+    QDir dir(tempDir.path());
+    auto echo = [=](const QString &filename, const QByteArray &content) {
+        QFile file(dir.absoluteFilePath(filename));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(content);
+        file.close();
+    };
+
+    // A truncated file with a complete temporary file:
+    echo("a.json", "{ \"Foo\": ");
+    echo(".a.json.abc123" + JsonUtils::TempFileSuffix, "{ \"Foo\": ");
+    echo(".a.json.def456" + JsonUtils::TempFileSuffix, "{ \"Foo\": \"New\" }");
+
+    // A valid file with a truncated temporary file:
+    echo("b.json", "{ \"Foo\": \"Old\" }");
+    echo(".b.json.abc123" + JsonUtils::TempFileSuffix, "{ \"Foo\": ");
+
+    // A temporary file without target:
+    echo(".c.json.abc123" + JsonUtils::TempFileSuffix, "{ \"Foo\": \"Orphan\" }");
+
+    QCOMPARE(JsonUtils::recoverTempFiles(dir.absolutePath()), 2);
+    QCOMPARE(loadMap(dir.absoluteFilePath("a.json")).value("Foo").toString(),
+             QString("New"));
+    QCOMPARE(loadMap(dir.absoluteFilePath("b.json")).value("Foo").toString(),
+             QString("Old"));
+    QCOMPARE(loadMap(dir.absoluteFilePath("c.json")).value("Foo").toString(),
+             QString("Orphan"));
+    QCOMPARE(dir.entryList(QDir::Files | QDir::Hidden).length(), 3);
+}
+
+void JsonUtilsTest::testConcurrentWrites()
+{
+    QTemporaryDir tempDir;
+    auto filename = tempDir.path() + "/test.json";
+    QList<int> values;
+    for (int i = 0; i < 20; ++i) {
+        values << i;
+    }
+    auto results = QtConcurrent::blockingMapped<QList<bool>>(
+                values, [=](int value) {
+        auto content = QString("{ \"Value\": %1 }").arg(value).toUtf8();
+        return JsonUtils::writeFileAtomically(filename, content);
+    });
+    QVERIFY(!results.contains(false));
+    bool ok;
+    auto value = loadMap(filename, &ok).value("Value").toInt();
+    QVERIFY(ok);
+    QVERIFY(values.contains(value));
+    QCOMPARE(QDir(tempDir.path()).entryList(
+                 QDir::Files | QDir::Hidden).length(), 1);
+}
+
+void JsonUtilsTest::testKeepPermissions()
+{
+#ifdef Q_OS_UNIX
+    QTemporaryDir tempDir;
+    auto filename = tempDir.path() + "/test.json";
+
+    // New files are readable by others:
+    QVERIFY(JsonUtils::writeFileAtomically(filename, "{}"));
+    QVERIFY(QFile::permissions(filename) & QFileDevice::ReadOther);
+
+    // The permissions of existing files are kept:
+    auto permissions = QFileDevice::ReadOwner | QFileDevice::WriteOwner |
+            QFileDevice::ReadGroup | QFileDevice::WriteGroup;
+    QVERIFY(QFile::setPermissions(filename, permissions));
+    auto expected = QFile::permissions(filename);
+    QVERIFY(patchJsonFile(filename, {{"Foo", "Bar"}}));
+    QCOMPARE(QFile::permissions(filename), expected);
+
+    // ... also when restoring files from temporary files:
+    QFile truncated(filename);
+    QVERIFY(truncated.open(QIODevice::WriteOnly));
+    truncated.write("{ \"Foo\": ");
+    truncated.close();
+    QFile tmpFile(tempDir.path() + "/.test.json.abc123" +
+                  JsonUtils::TempFileSuffix);
+    QVERIFY(tmpFile.open(QIODevice::WriteOnly));
+    tmpFile.write("{ \"Foo\": \"Baz\" }");
+    tmpFile.close();
+    QVERIFY(tmpFile.setPermissions(QFileDevice::ReadOwner |
+                                   QFileDevice::WriteOwner));
+    QCOMPARE(JsonUtils::recoverTempFiles(tempDir.path()), 1);
+    QCOMPARE(loadMap(filename).value("Foo").toString(), QString("Baz"));
+    QCOMPARE(QFile::permissions(filename), expected);
+#else
+    QSKIP("File permissions are only checked on Unix systems");
+#endif
+}
+
 QTEST_MAIN(JsonUtilsTest)
 #include "test_jsonutils.moc"
@@ -1,10 +1,12 @@
 #include "application.h"
 #include "image.h"
+#include "itemwriter.h"
 #include "library.h"
 #include "note.h"
 #include "todolist.h"
 #include "todo.h"
 #include "task.h"
+#include "utils/jsonutils.h"
 
 #include <QObject>
 #include <QQmlEngine>
@@ -32,8 +34,13 @@ private slots:
     void testAddTodoList();
     void testAddTodo();
     void addTask();
+    void testParentChildIndex();
+    void testSearch();
     void testTags();
+    void testItemsWithTags();
     void testLoad();
+    void testReloadChangedFiles();
+    void testReloadKeepsPendingWrites();
     void testDeleteLibrary();
     void testFromJson();
     void cleanup();
@@ -135,6 +142,65 @@ void LibraryTest::addTask()
     }
 }
 
+void LibraryTest::testParentChildIndex()
+{
+    Library lib(m_dir->path());
+    auto list1 = lib.addTodoList();
+    auto list2 = lib.addTodoList();
+    auto todo1 = list1->addTodo();
+    auto todo2 = list1->addTodo();
+    auto task1 = todo1->addTask();
+    auto task2 = todo1->addTask();
+
+    QCOMPARE(lib.todosOf(list1->uid()).toSet(), (QSet<Todo*>{todo1, todo2}));
+    QVERIFY(lib.todosOf(list2->uid()).isEmpty());
+    QCOMPARE(lib.tasksOf(todo1->uid()).toSet(), (QSet<Task*>{task1, task2}));
+    QVERIFY(lib.tasksOf(todo2->uid()).isEmpty());
+
+    todo2->setTodoListUid(list2->uid());
+    task2->setTodoUid(todo2->uid());
+    QCOMPARE(lib.todosOf(list1->uid()), QList<Todo*>({todo1}));
+    QCOMPARE(lib.todosOf(list2->uid()), QList<Todo*>({todo2}));
+    QCOMPARE(lib.tasksOf(todo1->uid()), QList<Task*>({task1}));
+    QCOMPARE(lib.tasksOf(todo2->uid()), QList<Task*>({task2}));
+
+    task1->deleteItem();
+    todo2->deleteItem();
+    QVERIFY(lib.tasksOf(todo1->uid()).isEmpty());
+    QVERIFY(lib.todosOf(list2->uid()).isEmpty());
+    QCOMPARE(lib.tasksOf(todo2->uid()), QList<Task*>({task2}));
+}
+
+void LibraryTest::testSearch()
+{
+    Library lib(m_dir->path());
+    QSignalSpy searchIndexChanged(&lib, &Library::searchIndexChanged);
+    auto note = lib.addNote();
+    note->setTitle("Shopping");
+    note->setNotes("Buy milk");
+    auto list = lib.addTodoList();
+    list->setTitle("Groceries");
+    auto todo = list->addTodo();
+    todo->setTitle("Bakery");
+    auto task = todo->addTask();
+    task->setTitle("Bread");
+    QVERIFY(searchIndexChanged.count() > 0);
+
+    QCOMPARE(lib.search("milk"), (QSet<QUuid>{note->uid()}));
+    QCOMPARE(lib.search("BREAD"),
+             (QSet<QUuid>{task->uid(), todo->uid(), list->uid()}));
+    QCOMPARE(lib.search("bak"), (QSet<QUuid>{todo->uid(), list->uid()}));
+    QCOMPARE(lib.search("shop groc"), (QSet<QUuid>{note->uid(), list->uid()}));
+
+    task->setTitle("Rolls");
+    QVERIFY(lib.search("bread").isEmpty());
+    QCOMPARE(lib.search("rolls"),
+             (QSet<QUuid>{task->uid(), todo->uid(), list->uid()}));
+
+    note->deleteItem();
+    QVERIFY(lib.search("milk").isEmpty());
+}
+
 void LibraryTest::testTags()
 {
     Library lib;
@@ -154,14 +220,48 @@ void LibraryTest::testTags()
     QCOMPARE(tagsChanged.count(), 1);
     QCOMPARE(lib.tags(), QStringList({"Foo"}));
 
+    // Foo already is used, so the list of tags does not change:
     note2->addTag("Foo");
-    note2->addTag("Bar");
-    QCOMPARE(tagsChanged.count(), 3);
-    QCOMPARE(lib.tags(), QStringList({"Bar", "Foo"}));
+    QCOMPARE(tagsChanged.count(), 1);
+    note2->addTag("bar");
+    QCOMPARE(tagsChanged.count(), 2);
+    QCOMPARE(lib.tags(), QStringList({"bar", "Foo"}));
 
     note2->setTags({});
-    QCOMPARE(tagsChanged.count(), 4);
+    QCOMPARE(tagsChanged.count(), 3);
     QCOMPARE(lib.tags(), QStringList({"Foo"}));
+
+    note1->deleteItem();
+    QCOMPARE(tagsChanged.count(), 4);
+    QCOMPARE(lib.tags(), QStringList());
+}
+
+void LibraryTest::testItemsWithTags()
+{
+    Library lib;
+    auto note1 = lib.addNote();
+    auto note2 = lib.addNote();
+    auto note3 = lib.addNote();
+    note1->setTags({"Foo", "Bar"});
+    note2->setTags({"Foo"});
+    note3->setTags({"Baz"});
+
+    QSignalSpy itemTagsChanged(&lib, &Library::itemTagsChanged);
+    QCOMPARE(lib.itemsWithTags({"Foo"}), (QSet<QUuid>{note1->uid(), note2->uid()}));
+    QCOMPARE(lib.itemsWithTags({"Foo", "Bar"}), (QSet<QUuid>{note1->uid()}));
+    QCOMPARE(lib.itemsWithTags({"Bar", "Baz"}, false),
+             (QSet<QUuid>{note1->uid(), note3->uid()}));
+    QVERIFY(lib.itemsWithTags({"Foo", "Qux"}).isEmpty());
+    QVERIFY(lib.itemsWithTags({}).isEmpty());
+
+    note2->addTag("Bar");
+    QCOMPARE(itemTagsChanged.count(), 1);
+    QCOMPARE(lib.itemsWithTags({"Foo", "Bar"}),
+             (QSet<QUuid>{note1->uid(), note2->uid()}));
+
+    note1->deleteItem();
+    QCOMPARE(itemTagsChanged.count(), 2);
+    QCOMPARE(lib.itemsWithTags({"Foo", "Bar"}), (QSet<QUuid>{note2->uid()}));
 }
 
 void LibraryTest::testLoad()
@@ -205,6 +305,78 @@ void LibraryTest::testLoad()
     QCOMPARE(files.count(), 5);
 }
 
+void LibraryTest::testReloadChangedFiles()
+{
+    Library lib(m_dir->path());
+    lib.save();
+    auto note = lib.addNote();
+    note->setTitle("A note");
+    auto filename = note->filename();
+    auto todoList = lib.addTodoList();
+    auto todoListFilename = todoList->filename();
+    ItemWriter::instance()->flush();
+
+    Library lib2(m_dir->path());
+    QSignalSpy loadingFinished(&lib2, &Library::loadingFinished);
+    QVERIFY(lib2.load());
+    QVERIFY(loadingFinished.wait(10000));
+    QThread::sleep(1);
+    QCOMPARE(lib2.topLevelItems()->count(), 2);
+    Item *note2 = nullptr;
+    for (int i = 0; i < 2; ++i) {
+        if (lib2.topLevelItems()->item(i)->filename() == filename) {
+            note2 = lib2.topLevelItems()->get(i);
+        }
+    }
+    QVERIFY(note2 != nullptr);
+
+    // Modify a file behind the back of the library:
+    QSignalSpy titleChanged(note2, &Item::titleChanged);
+    QVERIFY(JsonUtils::patchJsonFile(filename, {{"title", "Changed"}}));
+    QVERIFY(titleChanged.wait(15000));
+    QCOMPARE(note2->title(), QString("Changed"));
+
+    // Remove a file:
+    QSignalSpy countChanged(lib2.topLevelItems(), &ItemContainer::countChanged);
+    QVERIFY(QFile::remove(todoListFilename));
+    QVERIFY(countChanged.wait(15000));
+    QCOMPARE(lib2.topLevelItems()->count(), 1);
+    QCOMPARE(lib2.topLevelItems()->item(0)->filename(), filename);
+}
+
+void LibraryTest::testReloadKeepsPendingWrites()
+{
+    Library lib(m_dir->path());
+    lib.save();
+    auto note = lib.addNote();
+    auto filename = note->filename();
+    ItemWriter::instance()->flush();
+
+    Library lib2(m_dir->path());
+    QSignalSpy loadingFinished(&lib2, &Library::loadingFinished);
+    QVERIFY(lib2.load());
+    QVERIFY(loadingFinished.wait(10000));
+    QCOMPARE(lib2.topLevelItems()->count(), 1);
+    auto note2 = lib2.topLevelItems()->get(0);
+
+    // The file is changed on disk, so the library reloads it:
+    QSignalSpy filesChanged(&lib2, &Library::filesChanged);
+    note2->setTitle("First");
+    ItemWriter::instance()->flush();
+
+    // An edit made before the reload is still waiting to be written:
+    auto delay = ItemWriter::instance()->delay();
+    ItemWriter::instance()->setDelay(60000);
+    note2->setTitle("Second");
+    QVERIFY(ItemWriter::instance()->hasPendingWrites());
+    QVERIFY(filesChanged.wait(15000));
+    QTest::qWait(1000);
+    ItemWriter::instance()->setDelay(delay);
+    QCOMPARE(note2->title(), QString("Second"));
+    QCOMPARE(JsonUtils::loadMap(filename).value("title").toString(),
+             QString("Second"));
+}
+
 void LibraryTest::testDeleteLibrary()
 {
     QDir dir(m_dir->path() + "/Library");
@@ -0,0 +1,7 @@
+include(../../config.pri)
+setupTest(librarycache)
+
+include(../../lib/lib.pri)
+
+SOURCES += \
+    test_librarycache.cpp
@@ -0,0 +1,226 @@
+#include "librarycache.h"
+
+#include "itemwriter.h"
+#include "library.h"
+#include "libraryloader.h"
+#include "note.h"
+#include "todolist.h"
+#include "todo.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QObject>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+
+class LibraryCacheTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  void initTestCase() {}
+  void init();
+  void testSaveAndLoad();
+  void testLookupDetectsChanges();
+  void testIgnoreIncompatibleCache();
+  void testRemoveUnused();
+  void testLoaderUsesCache();
+  void benchmarkColdLoad();
+  void benchmarkWarmLoad();
+  void cleanup();
+  void cleanupTestCase() {}
+
+private:
+
+  QTemporaryDir *m_dir;
+
+  void createLibrary(int numItems);
+  int scan();
+
+};
+
+
+void LibraryCacheTest::init()
+{
+    m_dir = new QTemporaryDir();
+}
+
+void LibraryCacheTest::testSaveAndLoad()
+{
+    QFile file(m_dir->path() + "/item.otl");
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("{}");
+    file.close();
+    QFileInfo fi(file.fileName());
+
+    LibraryCache cache(m_dir->path());
+    QVERIFY(!cache.load());
+    QVariantMap data;
+    data["title"] = "Foo";
+    data["tags"] = QStringList({"Bar", "Baz"});
+    cache.insert("item.otl", fi, data);
+    QVERIFY(cache.isModified());
+    QVERIFY(cache.save());
+    QVERIFY(!cache.isModified());
+    QVERIFY(QFile::exists(m_dir->path() + "/" + LibraryCache::FileName));
+
+    LibraryCache cache2(m_dir->path());
+    QVERIFY(cache2.load());
+    QCOMPARE(cache2.count(), 1);
+    QVariantMap data2;
+    QVERIFY(cache2.lookup("item.otl", fi, &data2));
+    QCOMPARE(data2, data);
+    QVERIFY(!cache2.lookup("other.otl", fi, &data2));
+}
+
+void LibraryCacheTest::testLookupDetectsChanges()
+{
+    auto filename = m_dir->path() + "/item.otl";
+    QFile file(filename);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("{}");
+    file.close();
+
+    LibraryCache cache(m_dir->path());
+    cache.insert("item.otl", QFileInfo(filename), QVariantMap());
+    QVERIFY(cache.lookup("item.otl", QFileInfo(filename), nullptr));
+
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("{\"title\": \"Foo\"}");
+    file.close();
+    QVERIFY(!cache.lookup("item.otl", QFileInfo(filename), nullptr));
+}
+
+void LibraryCacheTest::testIgnoreIncompatibleCache()
+{
+    LibraryCache cache(m_dir->path());
+    QFile file(cache.fileName());
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    {
+        QDataStream stream(&file);
+        stream << LibraryCache::Magic << (LibraryCache::Version + 1)
+               << static_cast<quint32>(0);
+    }
+    file.close();
+    QVERIFY(!cache.load());
+    QCOMPARE(cache.count(), 0);
+
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("garbage");
+    file.close();
+    QVERIFY(!cache.load());
+    QCOMPARE(cache.count(), 0);
+}
+
+void LibraryCacheTest::testRemoveUnused()
+{
+    QFileInfo fi(m_dir->path());
+    LibraryCache cache(m_dir->path());
+    cache.insert("a.otl", fi, QVariantMap());
+    cache.insert("b.otl", fi, QVariantMap());
+    QVERIFY(cache.save());
+
+    QVERIFY(cache.load());
+    QVERIFY(cache.lookup("a.otl", fi, nullptr));
+    cache.removeUnused();
+    QVERIFY(cache.isModified());
+    QCOMPARE(cache.count(), 1);
+    QVERIFY(cache.lookup("a.otl", fi, nullptr));
+}
+
+void LibraryCacheTest::testLoaderUsesCache()
+{
+    {
+        Library lib(m_dir->path());
+        lib.addNote()->setTitle("A note");
+        auto todoList = lib.addTodoList();
+        todoList->addTodo()->setTitle("A todo");
+    }
+    auto cacheFile = m_dir->path() + "/" + LibraryCache::FileName;
+    QVERIFY(!QFile::exists(cacheFile));
+    QCOMPARE(scan(), 3);
+    QVERIFY(QFile::exists(cacheFile));
+
+    LibraryCache cache(m_dir->path());
+    QVERIFY(cache.load());
+    QCOMPARE(cache.count(), 3);
+    auto lastModified = QFileInfo(cacheFile).lastModified();
+
+    // A warm load restores the items from the cache:
+    Library lib(m_dir->path());
+    QSignalSpy loadingFinished(&lib, &Library::loadingFinished);
+    QVERIFY(lib.load());
+    QVERIFY(loadingFinished.wait(10000));
+    QCOMPARE(lib.topLevelItems()->count(), 2);
+    QCOMPARE(lib.todos()->count(), 1);
+    QCOMPARE(lib.todos()->item(0)->title(), QString("A todo"));
+    QVERIFY(!lib.todos()->item(0)->filename().isEmpty());
+    QCOMPARE(QFileInfo(cacheFile).lastModified(), lastModified);
+
+    // Deleted files are dropped from the cache:
+    QVERIFY(QFile::remove(lib.todos()->item(0)->filename()));
+    QCOMPARE(scan(), 2);
+    QVERIFY(cache.load());
+    QCOMPARE(cache.count(), 2);
+}
+
+void LibraryCacheTest::benchmarkColdLoad()
+{
+    createLibrary(qEnvironmentVariableIsSet("OTL_BENCHMARK_ITEMS") ?
+                      qgetenv("OTL_BENCHMARK_ITEMS").toInt() : 1000);
+    QFile::remove(m_dir->path() + "/" + LibraryCache::FileName);
+    QBENCHMARK_ONCE {
+        scan();
+    }
+}
+
+void LibraryCacheTest::benchmarkWarmLoad()
+{
+    createLibrary(qEnvironmentVariableIsSet("OTL_BENCHMARK_ITEMS") ?
+                      qgetenv("OTL_BENCHMARK_ITEMS").toInt() : 1000);
+    scan();
+    QBENCHMARK_ONCE {
+        scan();
+    }
+}
+
+void LibraryCacheTest::cleanup()
+{
+    delete m_dir;
+}
+
+void LibraryCacheTest::createLibrary(int numItems)
+{
+    Library lib(m_dir->path());
+    for (int i = 0; i < numItems; ++i) {
+        auto note = lib.addNote();
+        note->setTitle(QString("Note %1").arg(i));
+        note->setNotes("Lorem ipsum dolor sit amet, consectetur adipiscing elit.");
+        note->setTags({"Foo", "Bar"});
+    }
+}
+
+int LibraryCacheTest::scan()
+{
+    ItemWriter::instance()->flush();
+    LibraryLoader loader;
+    loader.setDirectory(m_dir->path());
+    int result = 0;
+    connect(&loader, &LibraryLoader::itemsLoaded, [&](QList<ItemPtr> items) {
+        result += items.count();
+    });
+    QSignalSpy scanFinished(&loader, &LibraryLoader::scanFinished);
+    loader.scan();
+    if (!scanFinished.wait(600000)) {
+        return -1;
+    }
+    return result;
+}
+
+
+QTEST_MAIN(LibraryCacheTest)
+#include "test_librarycache.moc"
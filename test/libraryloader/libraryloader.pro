@@ -0,0 +1,7 @@
+include(../../config.pri)
+setupTest(libraryloader)
+
+include(../../lib/lib.pri)
+
+SOURCES += \
+    test_libraryloader.cpp
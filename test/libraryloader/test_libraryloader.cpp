@@ -0,0 +1,105 @@
+#include "libraryloader.h"
+
+#include "itemwriter.h"
+#include "library.h"
+#include "note.h"
+
+#include <QObject>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+
+class LibraryLoaderTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  void initTestCase() {}
+  void init();
+  void testThreadCount();
+  void testScan();
+  void testDeterministicOrder();
+  void cleanup();
+  void cleanupTestCase() {}
+
+private:
+
+  QTemporaryDir *m_dir;
+
+  QStringList scan(int threadCount);
+
+};
+
+
+void LibraryLoaderTest::init()
+{
+    m_dir = new QTemporaryDir();
+}
+
+void LibraryLoaderTest::testThreadCount()
+{
+    LibraryLoader loader;
+    QCOMPARE(loader.threadCount(), QThread::idealThreadCount());
+    loader.setThreadCount(3);
+    QCOMPARE(loader.threadCount(), 3);
+    loader.setThreadCount(0);
+    QCOMPARE(loader.threadCount(), 1);
+}
+
+void LibraryLoaderTest::testScan()
+{
+    {
+        Library lib(m_dir->path());
+        for (int i = 0; i < 10; ++i) {
+            lib.addNote()->setTitle(QString("Note %1").arg(i));
+        }
+    }
+    auto files = scan(4);
+    QCOMPARE(files.count(), 10);
+    QCOMPARE(files.toSet().count(), 10);
+}
+
+void LibraryLoaderTest::testDeterministicOrder()
+{
+    {
+        Library lib(m_dir->path());
+        for (int i = 0; i < 500; ++i) {
+            lib.addNote();
+        }
+    }
+    auto sequential = scan(1);
+    QCOMPARE(sequential.count(), 500);
+    QCOMPARE(scan(8), sequential);
+    QCOMPARE(scan(8), sequential);
+}
+
+void LibraryLoaderTest::cleanup()
+{
+    delete m_dir;
+}
+
+QStringList LibraryLoaderTest::scan(int threadCount)
+{
+    QStringList result;
+    ItemWriter::instance()->flush();
+    LibraryLoader loader;
+    loader.setDirectory(m_dir->path());
+    loader.setThreadCount(threadCount);
+    connect(&loader, &LibraryLoader::itemsLoaded, [&](QList<ItemPtr> items) {
+        for (auto item : items) {
+            result << item->filename();
+        }
+    });
+    QSignalSpy scanFinished(&loader, &LibraryLoader::scanFinished);
+    loader.scan();
+    if (!scanFinished.wait(60000)) {
+        return QStringList();
+    }
+    return result;
+}
+
+
+QTEST_MAIN(LibraryLoaderTest)
+#include "test_libraryloader.moc"
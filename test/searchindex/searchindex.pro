@@ -0,0 +1,7 @@
+include(../../config.pri)
+setupTest(searchindex)
+
+include(../../lib/lib.pri)
+
+SOURCES += \
+    test_searchindex.cpp
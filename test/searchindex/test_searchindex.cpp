@@ -0,0 +1,103 @@
+#include "searchindex.h"
+
+#include <QObject>
+#include <QTest>
+
+#include "note.h"
+
+
+class SearchIndexTest : public QObject
+{
+  Q_OBJECT
+
+private slots:
+
+  void initTestCase() {}
+  void testTokenize();
+  void testFind();
+  void testParents();
+  void testUpdate();
+  void cleanupTestCase() {}
+
+};
+
+
+void SearchIndexTest::testTokenize()
+{
+    QCOMPARE(SearchIndex::tokenize("Buy Milk, Butter & Crème brûlée!"),
+             QStringList({"buy", "milk", "butter", "creme", "brulee"}));
+    QCOMPARE(SearchIndex::tokenize("  "), QStringList());
+    QCOMPARE(SearchIndex::tokenize("todo-list 2"),
+             QStringList({"todo", "list", "2"}));
+}
+
+void SearchIndexTest::testFind()
+{
+    Note note1;
+    Note note2;
+    Note note3;
+    SearchIndex index;
+    index.insert(&note1, note1.uid(), "Buy milk");
+    index.insert(&note2, note2.uid(), "Bake a cake\nUse butter");
+    index.insert(&note3, note3.uid(), "Crème brûlée");
+    QCOMPARE(index.count(), 3);
+
+    QCOMPARE(index.find("bu"), (QSet<QUuid>{note1.uid(), note2.uid()}));
+    QCOMPARE(index.find("MILK"), (QSet<QUuid>{note1.uid()}));
+    QCOMPARE(index.find("brulee"), (QSet<QUuid>{note3.uid()}));
+    QCOMPARE(index.find("milk creme"), (QSet<QUuid>{note1.uid(), note3.uid()}));
+    QVERIFY(index.find("ilk").isEmpty());
+    QVERIFY(index.find("").isEmpty());
+
+    QAtomicInt cancelled(1);
+    QVERIFY(index.find("bu", &cancelled).isEmpty());
+}
+
+void SearchIndexTest::testParents()
+{
+    Note note1;
+    Note note2;
+    Note note3;
+    SearchIndex index;
+    index.insert(&note1, note1.uid(), "Groceries");
+    index.insert(&note2, note2.uid(), "Bakery");
+    index.insert(&note3, note3.uid(), "Bread");
+    index.setParent(&note2, note1.uid());
+    index.setParent(&note3, note2.uid());
+    QCOMPARE(index.find("bread"),
+             (QSet<QUuid>{note1.uid(), note2.uid(), note3.uid()}));
+    QCOMPARE(index.find("bakery"), (QSet<QUuid>{note1.uid(), note2.uid()}));
+
+    index.insert(&note3, note3.uid(), "Rolls");
+    QCOMPARE(index.find("rolls"),
+             (QSet<QUuid>{note1.uid(), note2.uid(), note3.uid()}));
+    index.setParent(&note3, QUuid());
+    QCOMPARE(index.find("rolls"), (QSet<QUuid>{note3.uid()}));
+}
+
+void SearchIndexTest::testUpdate()
+{
+    Note note1;
+    Note note2;
+    SearchIndex index;
+    index.insert(&note1, note1.uid(), "Buy milk");
+    index.insert(&note2, note2.uid(), "Buy bread");
+    index.insert(&note1, note1.uid(), "Sell milk");
+    QCOMPARE(index.find("buy"), (QSet<QUuid>{note2.uid()}));
+    QCOMPARE(index.find("sell"), (QSet<QUuid>{note1.uid()}));
+
+    auto copy = index;
+    QVERIFY(index.remove(&note2));
+    QVERIFY(!index.remove(&note2));
+    QVERIFY(!index.contains(&note2));
+    QVERIFY(index.find("buy").isEmpty());
+    QCOMPARE(index.count(), 1);
+    QCOMPARE(copy.find("buy"), (QSet<QUuid>{note2.uid()}));
+
+    index.clear();
+    QCOMPARE(index.count(), 0);
+    QVERIFY(index.find("sell").isEmpty());
+}
+
+QTEST_MAIN(SearchIndexTest)
+#include "test_searchindex.moc"
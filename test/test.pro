@@ -10,9 +10,16 @@ SUBDIRS += task
 SUBDIRS += todo
 SUBDIRS += todolist
 SUBDIRS += library
+SUBDIRS += librarycache
+SUBDIRS += libraryloader
+SUBDIRS += searchindex
+SUBDIRS += itemrecordstore
 SUBDIRS += itemsmodel
+SUBDIRS += itemssortfiltermodel
 SUBDIRS += itemcontainer
+SUBDIRS += itemwriter
 SUBDIRS += keystore
 SUBDIRS += jsonutils
+SUBDIRS += directorywatcher
 SUBDIRS += synchronizer
 SUBDIRS += webdavsynchronizer
@@ -1,5 +1,7 @@
 #include "todo.h"
+#include "library.h"
 #include "task.h"
+#include "todolist.h"
 
 #include <QObject>
 #include <QSignalSpy>
@@ -16,6 +18,7 @@ private slots:
     void initTestCase() {}
     void testProperties();
     void testPersistence();
+    void testPercentageDone();
     void cleanupTestCase() {}
 };
 
@@ -64,5 +67,42 @@ void TodoTest::testPersistence()
 }
 
 
+void TodoTest::testPercentageDone()
+{
+    Library lib;
+    auto list = lib.addTodoList();
+    auto todo1 = list->addTodo();
+    auto todo2 = list->addTodo();
+    QCOMPARE(todo1->percentageDone(), 0);
+
+    QSignalSpy todo1Changed(todo1, &Todo::percentageDoneChanged);
+    QSignalSpy todo2Changed(todo2, &Todo::percentageDoneChanged);
+    auto task1 = todo1->addTask();
+    auto task2 = todo1->addTask();
+    QVERIFY(todo1Changed.count() > 0);
+    QCOMPARE(todo2Changed.count(), 0);
+    QCOMPARE(todo1->percentageDone(), 0);
+
+    todo1Changed.clear();
+    task1->setDone(true);
+    QCOMPARE(todo1Changed.count(), 1);
+    QCOMPARE(todo2Changed.count(), 0);
+    QCOMPARE(todo1->percentageDone(), 50);
+
+    task2->setTodoUid(todo2->uid());
+    QCOMPARE(todo1->percentageDone(), 100);
+    QCOMPARE(todo2->percentageDone(), 0);
+    QCOMPARE(todo2Changed.count(), 1);
+
+    task2->setDone(true);
+    QCOMPARE(todo2->percentageDone(), 100);
+
+    todo1Changed.clear();
+    task1->deleteItem();
+    QCOMPARE(todo1Changed.count(), 1);
+    QCOMPARE(todo1->percentageDone(), 0);
+}
+
+
 QTEST_MAIN(TodoTest)
 #include "test_todo.moc"
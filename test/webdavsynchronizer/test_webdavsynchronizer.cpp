@@ -11,12 +11,17 @@
 #include "datamodel/todo.h"
 #include "datamodel/task.h"
 
+#include <QDir>
+#include <QDomDocument>
+#include <QMutex>
 #include <QObject>
 #include <QObjectList>
 #include <QRegularExpression>
 #include <QSignalSpy>
+#include <QSqlQuery>
 #include <QTemporaryDir>
 #include <QTest>
+#include <QThread>
 #include <QUuid>
 #include <QSet>
 
@@ -36,9 +41,16 @@ private slots:
     void disableCertificateCheck();
     void username();
     void password();
+    void maxConcurrentTransfers();
 
     void mkpath();
     void splitpath();
+    void remoteTreeFromEntries();
+    void parseEntryList();
+    void syncDB();
+    void syncDirectories();
+    void benchmarkParseDom();
+    void benchmarkParseStream();
 
 # ifdef TEST_AGAINST_SERVER
     void validate();
@@ -68,6 +80,13 @@ private slots:
 private:
     void createDavClients();
     void echoToFile(const QString& text, const QString& filename);
+    QByteArray propFindResponse(int numFiles);
+    int benchmarkEntries() const;
+    static WebDAVClient::EntryList parsePropFindResponse(
+            const QUrl &baseUrl, const QDomDocument& response,
+            const QString& directory);
+    static WebDAVClient::Entry parseResponseEntry(const QDomElement& element,
+                                                  const QString& baseDir);
     QByteArray catFile(const QString &filename);
 };
 
@@ -114,6 +133,17 @@ void WebDAVSynchronizerTest::password()
     QCOMPARE(spy.count(), 1);
 }
 
+void WebDAVSynchronizerTest::maxConcurrentTransfers()
+{
+    WebDAVClient client;
+    QCOMPARE(client.maxConcurrentTransfers(),
+             WebDAVClient::DefaultMaxConcurrentTransfers);
+    client.setMaxConcurrentTransfers(2);
+    QCOMPARE(client.maxConcurrentTransfers(), 2);
+    client.setMaxConcurrentTransfers(0);
+    QCOMPARE(client.maxConcurrentTransfers(), 1);
+}
+
 void WebDAVSynchronizerTest::mkpath()
 {
     QCOMPARE(WebDAVClient::mkpath(""), QString(""));
@@ -133,6 +163,275 @@ void WebDAVSynchronizerTest::splitpath()
              std::make_tuple(QString("foo"), QString("bar")));
 }
 
+void WebDAVSynchronizerTest::remoteTreeFromEntries()
+{
+    WebDAVClient::EntryList entries;
+    auto addEntry = [&](const QString &name, WebDAVClient::EntryType type) {
+        WebDAVClient::Entry entry;
+        entry.name = name;
+        entry.type = type;
+        entry.etag = "etag-" + name;
+        entries << entry;
+    };
+    addEntry(".", WebDAVClient::Directory);
+    addEntry("library.json", WebDAVClient::File);
+    addEntry("2017", WebDAVClient::Directory);
+    addEntry("2017/1", WebDAVClient::Directory);
+    addEntry("2017/1/foo.otl", WebDAVClient::File);
+    addEntry("2017/2", WebDAVClient::Directory);
+
+    auto tree = WebDAVClient::remoteTreeFromEntries(entries);
+    QCOMPARE(tree.keys().toSet(),
+             QSet<QString>({"", "2017", "2017/1", "2017/2"}));
+    QCOMPARE(tree.value("").length(), 2);
+    QCOMPARE(tree.value("2017").length(), 2);
+    QCOMPARE(tree.value("2017/1").length(), 1);
+    QCOMPARE(tree.value("2017/1").at(0).name, QString("foo.otl"));
+    QCOMPARE(tree.value("2017/1").at(0).etag, QString("etag-2017/1/foo.otl"));
+    QCOMPARE(tree.value("2017/1").at(0).type, WebDAVClient::File);
+    QVERIFY(tree.value("2017/2").isEmpty());
+}
+
+void WebDAVSynchronizerTest::parseEntryList()
+{
+    QUrl baseUrl("https://example.com/remote.php/webdav/");
+    auto response = propFindResponse(3);
+
+    QDomDocument doc;
+    QVERIFY(doc.setContent(response));
+    auto expected = parsePropFindResponse(baseUrl, doc, "lib");
+    QCOMPARE(expected.length(), 5);
+
+    // Parse at once and in small chunks, as if data arrives from the network:
+    auto entries = WebDAVClient::parseEntryList(baseUrl, "lib", response);
+    WebDAVClient::PropFindParser parser(baseUrl, "lib");
+    WebDAVClient::EntryList chunkedEntries;
+    for (int i = 0; i < response.length(); i += 7) {
+        parser.addData(response.mid(i, 7));
+        chunkedEntries << parser.takeEntries();
+    }
+    QVERIFY(!parser.hasError());
+    for (auto list : {entries, chunkedEntries}) {
+        QCOMPARE(list.length(), expected.length());
+        for (int i = 0; i < list.length(); ++i) {
+            QCOMPARE(list[i].name, expected[i].name);
+            QCOMPARE(list[i].type, expected[i].type);
+            QCOMPARE(list[i].etag, expected[i].etag);
+        }
+    }
+    QCOMPARE(entries[0].name, QString("."));
+    QCOMPARE(entries[0].type, WebDAVClient::Directory);
+    QCOMPARE(entries[1].name, QString("2017"));
+    QCOMPARE(entries[1].type, WebDAVClient::Directory);
+    QCOMPARE(entries[2].name, QString("file 0.otl"));
+    QCOMPARE(entries[2].type, WebDAVClient::File);
+    QCOMPARE(entries[2].etag, QString("\"etag0\""));
+
+    // Namespace prefixes are not fixed and the status might come last:
+    QByteArray other = "<?xml version=\"1.0\"?>"
+                       "<D:multistatus xmlns:D=\"DAV:\">"
+                       "<D:response>"
+                       "<D:href>/remote.php/webdav/lib/foo/</D:href>"
+                       "<D:propstat>"
+                       "<D:prop><D:resourcetype><D:collection/></D:resourcetype>"
+                       "<D:getetag>\"abc\"</D:getetag></D:prop>"
+                       "<D:status>HTTP/1.1 200 OK</D:status>"
+                       "</D:propstat>"
+                       "<D:propstat>"
+                       "<D:prop><D:getetag>\"wrong\"</D:getetag></D:prop>"
+                       "<D:status>HTTP/1.1 404 Not Found</D:status>"
+                       "</D:propstat>"
+                       "</D:response>"
+                       "</D:multistatus>";
+    entries = WebDAVClient::parseEntryList(baseUrl, "lib", other);
+    QCOMPARE(entries.length(), 1);
+    QCOMPARE(entries[0].name, QString("foo"));
+    QCOMPARE(entries[0].type, WebDAVClient::Directory);
+    QCOMPARE(entries[0].etag, QString("\"abc\""));
+
+    // Invalid responses:
+    WebDAVClient::PropFindParser invalid(baseUrl, "lib");
+    invalid.addData("<html><body>Error</body></html>");
+    QVERIFY(invalid.hasError());
+    QVERIFY(invalid.takeEntries().isEmpty());
+}
+
+void WebDAVSynchronizerTest::syncDB()
+{
+    QTemporaryDir dir;
+    QString connectionName;
+    {
+        WebDAVClient client;
+        client.setDirectory(dir.path());
+        auto db = client.openSyncDb();
+        connectionName = db.connectionName();
+        QVERIFY(db.isOpen());
+        // The connection is kept open:
+        QCOMPARE(client.openSyncDb().connectionName(), connectionName);
+
+        QSqlQuery query(db);
+        QVERIFY(query.exec("PRAGMA journal_mode;"));
+        QVERIFY(query.first());
+        QCOMPARE(query.value(0).toString().toLower(), QString("wal"));
+
+        WebDAVClient::SyncDBChanges changes;
+        for (int i = 0; i < 1000; ++i) {
+            WebDAVClient::SyncEntry entry;
+            entry.parent = "2017/1";
+            entry.entry = QString("item%1.otl").arg(i);
+            entry.lastModDate = QDateTime::currentDateTime();
+            entry.etag = QString("etag%1").arg(i);
+            changes << WebDAVClient::SyncDBChange(
+                           WebDAVClient::InsertIntoSyncDB, entry);
+        }
+        WebDAVClient::SyncEntry month;
+        month.parent = "2017";
+        month.entry = "1";
+        month.etag = "month";
+        month.lastModDate = QDateTime::currentDateTime();
+        changes << WebDAVClient::SyncDBChange(
+                       WebDAVClient::InsertIntoSyncDB, month);
+        client.applySyncDBChanges(db, changes);
+
+        auto entries = client.findSyncDBEntries(db, "2017/1");
+        QCOMPARE(entries.count(), 1000);
+        QCOMPARE(entries.value("item42.otl").previousEtag, QString("etag42"));
+        QCOMPARE(client.findSyncDBEntries(db, "2017").count(), 1);
+
+        changes.clear();
+        changes << WebDAVClient::SyncDBChange(
+                       WebDAVClient::RemoveFileFromSyncDB,
+                       entries.value("item42.otl"));
+        client.applySyncDBChanges(db, changes);
+        QCOMPARE(client.findSyncDBEntries(db, "2017/1").count(), 999);
+
+        changes.clear();
+        changes << WebDAVClient::SyncDBChange(
+                       WebDAVClient::RemoveDirFromSyncDB, month);
+        client.applySyncDBChanges(db, changes);
+        QCOMPARE(client.findSyncDBEntries(db, "2017/1").count(), 0);
+        QCOMPARE(client.findSyncDBEntries(db, "2017").count(), 0);
+    }
+    // ... until the client is destroyed:
+    QVERIFY(!QSqlDatabase::contains(connectionName));
+}
+
+void WebDAVSynchronizerTest::syncDirectories()
+{
+    typedef WebDAVSynchronizer::DirectorySync DirectorySync;
+    QList<DirectorySync> directories;
+    for (int i = 1; i <= 12; ++i) {
+        DirectorySync dir;
+        dir.path = QString("2017/%1").arg(i);
+        dir.pushOnly = false;
+        directories << dir;
+    }
+    WebDAVClient client;
+
+    {
+        // All directories are synced once, in order and with a bounded
+        // number of workers:
+        WebDAVSynchronizer sync;
+        QMutex mutex;
+        QStringList started;
+        QAtomicInt running(0);
+        QAtomicInt maxRunning(0);
+        sync.syncDirectories(directories, &client, [&](
+                             WebDAVClient *, const DirectorySync &dir) {
+            {
+                QMutexLocker locker(&mutex);
+                started << dir.path;
+            }
+            int current = running.fetchAndAddOrdered(1) + 1;
+            int max = maxRunning.loadAcquire();
+            while (current > max &&
+                   !maxRunning.testAndSetOrdered(max, current)) {
+                max = maxRunning.loadAcquire();
+            }
+            QThread::msleep(20);
+            running.fetchAndAddOrdered(-1);
+            return true;
+        });
+        QCOMPARE(started.length(), directories.length());
+        for (int i = 0; i < directories.length(); ++i) {
+            auto pos = started.indexOf(directories.at(i).path);
+            QVERIFY(pos >= 0);
+            QVERIFY(qAbs(pos - i) < WebDAVSynchronizer::MaxConcurrentDirectories);
+        }
+        QVERIFY(maxRunning.loadAcquire() > 1);
+        QVERIFY(maxRunning.loadAcquire() <=
+                WebDAVSynchronizer::MaxConcurrentDirectories);
+    }
+
+    {
+        // The connections are shared between the workers, so a single
+        // directory can use all of them:
+        WebDAVSynchronizer sync;
+        int maxTransfers = 0;
+        int acquired = 0;
+        sync.syncDirectories(directories.mid(0, 1), &client, [&](
+                             WebDAVClient *dav, const DirectorySync &) {
+            maxTransfers = dav->maxConcurrentTransfers();
+            while (acquired <= WebDAVSynchronizer::MaxConnections &&
+                   dav->acquireTransferSlot(false)) {
+                ++acquired;
+            }
+            for (int i = 0; i < acquired; ++i) {
+                dav->releaseTransferSlot();
+            }
+            return true;
+        });
+        QCOMPARE(maxTransfers, WebDAVSynchronizer::MaxConnections);
+        QCOMPARE(acquired, WebDAVSynchronizer::MaxConnections);
+    }
+
+    {
+        // Once stopped, no further directories are started and the stop
+        // request reaches the clients of all workers:
+        WebDAVSynchronizer sync;
+        QAtomicInt calls(0);
+        QAtomicInt stoppedClients(0);
+        sync.syncDirectories(directories, &client, [&](
+                             WebDAVClient *dav, const DirectorySync &) {
+            if (calls.fetchAndAddOrdered(1) == 2) {
+                sync.stopSync();
+            }
+            QThread::msleep(20);
+            if (dav->m_stopRequested.loadAcquire()) {
+                stoppedClients.fetchAndAddOrdered(1);
+            }
+            return true;
+        });
+        QVERIFY(calls.loadAcquire() >= 3);
+        QVERIFY(calls.loadAcquire() < 3 + WebDAVSynchronizer::MaxConcurrentDirectories);
+        QVERIFY(stoppedClients.loadAcquire() >= 1);
+    }
+}
+
+void WebDAVSynchronizerTest::benchmarkParseDom()
+{
+    QUrl baseUrl("https://example.com/remote.php/webdav/");
+    auto response = propFindResponse(benchmarkEntries());
+    WebDAVClient::EntryList entries;
+    QBENCHMARK {
+        QDomDocument doc;
+        doc.setContent(response);
+        entries = parsePropFindResponse(baseUrl, doc, "lib");
+    }
+    QCOMPARE(entries.length(), benchmarkEntries() + 2);
+}
+
+void WebDAVSynchronizerTest::benchmarkParseStream()
+{
+    QUrl baseUrl("https://example.com/remote.php/webdav/");
+    auto response = propFindResponse(benchmarkEntries());
+    WebDAVClient::EntryList entries;
+    QBENCHMARK {
+        entries = WebDAVClient::parseEntryList(baseUrl, "lib", response);
+    }
+    QCOMPARE(entries.length(), benchmarkEntries() + 2);
+}
+
 # ifdef TEST_AGAINST_SERVER
 
 void WebDAVSynchronizerTest::validate()
@@ -566,5 +865,116 @@ QByteArray WebDAVSynchronizerTest::catFile(const QString &filename)
     return result;
 }
 
+/**
+ * @brief Create a PROPFIND response listing the directory "lib".
+ *
+ * The response contains the directory itself, a sub-directory and
+ * @p numFiles files.
+ */
+QByteArray WebDAVSynchronizerTest::propFindResponse(int numFiles)
+{
+    auto response = [](const QString &href, bool isDir, const QString &etag) {
+        return QString("<d:response>"
+                       "<d:href>%1</d:href>"
+                       "<d:propstat>"
+                       "<d:prop>"
+                       "<d:resourcetype>%2</d:resourcetype>"
+                       "<d:getetag>&quot;%3&quot;</d:getetag>"
+                       "</d:prop>"
+                       "<d:status>HTTP/1.1 200 OK</d:status>"
+                       "</d:propstat>"
+                       "</d:response>")
+                .arg(href, isDir ? QString("<d:collection/>") : QString(),
+                     etag);
+    };
+    QString result = "<?xml version=\"1.0\"?>"
+                     "<d:multistatus xmlns:d=\"DAV:\" "
+                     "xmlns:s=\"http://sabredav.org/ns\">";
+    result += response("/remote.php/webdav/lib/", true, "root");
+    result += response("/remote.php/webdav/lib/2017/", true, "dir");
+    for (int i = 0; i < numFiles; ++i) {
+        result += response(QString("/remote.php/webdav/lib/file%20%1.otl").arg(i),
+                           false, QString("etag%1").arg(i));
+    }
+    result += "</d:multistatus>";
+    return result.toUtf8();
+}
+
+int WebDAVSynchronizerTest::benchmarkEntries() const
+{
+    return qEnvironmentVariableIsSet("OTL_BENCHMARK_ITEMS") ?
+                qgetenv("OTL_BENCHMARK_ITEMS").toInt() : 10000;
+}
+
+/**
+ * @brief Parse a PROPFIND @p response using the DOM.
+ *
+ * This is used as reference for the stream based parser of the
+ * WebDAVClient.
+ */
+WebDAVClient::EntryList WebDAVSynchronizerTest::parsePropFindResponse(
+        const QUrl &baseUrl, const QDomDocument& response, const QString& directory)
+{
+    WebDAVClient::EntryList result;
+    auto baseDir = QDir::cleanPath(baseUrl.path() + "/" + directory);
+    auto root = response.documentElement();
+    auto rootTagName = root.tagName();
+    if (rootTagName == "d:multistatus") {
+        auto resp = root.firstChildElement("d:response");
+        while (resp.isElement()) {
+            auto entry = parseResponseEntry(resp, baseDir);
+            if (entry.type != WebDAVClient::Invalid) {
+                result << entry;
+            }
+            resp = resp.nextSiblingElement("d:response");
+        }
+    } else {
+        qWarning() << "Received invalid WebDAV response from"
+                      "server starting with element" << rootTagName;
+    }
+    return result;
+}
+
+WebDAVClient::Entry WebDAVSynchronizerTest::parseResponseEntry(
+        const QDomElement& element, const QString& baseDir)
+{
+    auto type = WebDAVClient::File;
+    QString etag;
+
+    auto propstats = element.elementsByTagName("d:propstat");
+    for (int i = 0; i < propstats.length(); ++i) {
+        auto propstat = propstats.at(i).toElement();
+        auto status = propstat.firstChildElement("d:status");
+        if (status.text().endsWith("200 OK")) {
+            auto prop = propstat.firstChildElement("d:prop");
+            auto child = prop.firstChildElement();
+            while (child.isElement()) {
+                if (child.tagName() == "d:resourcetype") {
+                    if (child.firstChildElement().tagName() == "d:collection") {
+                        type = WebDAVClient::Directory;
+                    }
+                } else if (child.tagName() == "d:getetag") {
+                    etag = child.text();
+                } else {
+                    qWarning() << "Unknown DAV Property:" << child.tagName();
+                }
+                child = child.nextSiblingElement();
+            }
+        } else {
+            qWarning() << "Properties not retrieved -" << status.text();
+        }
+    }
+
+    QString path = QByteArray::fromPercentEncoding(
+                element.firstChildElement("d:href").text().toUtf8());
+
+    path = QDir(baseDir).relativeFilePath(path);
+    WebDAVClient::Entry result;
+    result.type = type;
+    result.etag = etag;
+    result.name = path;
+    return result;
+}
+
 QTEST_MAIN(WebDAVSynchronizerTest)
 #include "test_webdavsynchronizer.moc"